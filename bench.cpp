@@ -0,0 +1,437 @@
+// bench.cpp
+
+#include "opencv2/opencv.hpp"
+
+#define CV2_PUTTEXT_HPP_IMPL
+#include "cv2_putText.hpp"
+#define CV2_PUTTEXT_FANCY_HPP_IMPL
+#include "cv2_putText_fancy.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+
+// Best of `reps` runs, in microseconds; the minimum is the least noisy estimate
+static double timeUs(const std::function<void()>& fn, int reps = 20) {
+  double best = 1e300;
+  for(int i = 0; i < reps; ++i){
+    const int64 t0 = cv::getTickCount();
+    fn();
+    best = std::min(best, (cv::getTickCount() - t0)*1e6/cv::getTickFrequency());
+  }
+  return best;
+}
+
+// mask_blend::blend (universal intrinsics) vs mask_blend::blendScalar (reference),
+// compositing a full frame of rendered text masks
+static void benchMaskBlend() {
+  cv::Mat mask(720, 1280, CV_8UC1, cv::Scalar::all(0));
+  for(int y = 30; y < mask.rows; y += 30)
+    cv::putText(mask, "The quick brown fox jumps over the lazy dog 0123456789", cv::Point(10, y),
+        cv::FONT_HERSHEY_SIMPLEX, 0.8, cv::Scalar::all(255), 2, cv::LINE_AA);
+
+  std::printf("%-22s %12s %12s %8s\n", "mask_blend 1280x720", "scalar (us)", "simd (us)", "speedup");
+  for(const int type : {CV_8UC1, CV_8UC3, CV_8UC4}){
+    cv::Mat img(mask.size(), type, cv::Scalar(40, 80, 120, 255));
+    const cv::Scalar color(255, 255, 255, 255);
+    const double scalar = timeUs([&]{ cv::mask_blend::blendScalar(img, mask, color); });
+    const double simd = timeUs([&]{ cv::mask_blend::blend(img, mask, color); });
+    std::printf("%-22s %12.1f %12.1f %7.2fx\n",
+        type == CV_8UC1 ? "  CV_8UC1" : type == CV_8UC3 ? "  CV_8UC3" : "  CV_8UC4",
+        scalar, simd, scalar/simd);
+  }
+}
+
+// The Fancy_Outline and Fancy_Shadow test scenes. With Backend::Atlas, each outlined line is
+// composited in one pass from cached masks, instead of two cv::putText() calls.
+static void outlineScene(cv::Mat& img, cv::image_ostream::Backend backend) {
+  auto out = cv::putTextOutline(img, cv::Point(40, 40), fancy::White, 1, 1.0, 1.0, fancy::Black, 1);
+  out.backend(backend);
+  for(const double scale : {1.0, 2.0, 0.5})
+    for(const auto& t : {std::make_pair(1, 1), std::make_pair(1, 2), std::make_pair(1, 4),
+        std::make_pair(2, 2), std::make_pair(2, 4), std::make_pair(4, 4), std::make_pair(4, 2)})
+      out << cv::putTextOutline(fancy::White, t.first, scale, 1.0, fancy::Black, t.second)
+        << "Scale " << scale << ", Thickness " << t.first << ", Outline " << t.second << std::endl;
+}
+
+static void shadowScene(cv::Mat& img, cv::image_ostream::Backend backend) {
+  cv::putTextFancy(img, cv::Point(30, 20), fancy::Shadow, 4, true).backend(backend)
+    << "Shadowed Text:\n"
+    << "putText(img, orgin, kShadow, 4, true)" << std::endl
+  << cv::putText()
+    << "Space out with default (reg) putText()" << std::endl
+  << cv::putTextShadow()
+    << "putTextShadow() for shadowed text" << std::endl
+  << cv::putTextShadow(fancy::Blue, 3, 1.3)
+    << "putTextShadow(kBlue, 3, 1.3)" << std::endl;
+}
+
+static void benchOutline() {
+  using Backend = cv::image_ostream::Backend;
+  std::printf("%-22s %12s %12s %8s\n", "outline", "stroke (us)", "atlas (us)", "speedup");
+  const std::pair<const char*, void(*)(cv::Mat&, Backend)> scenes[] = {
+    {"  Fancy_Outline", outlineScene}, {"  Fancy_Shadow", shadowScene}};
+  for(const auto& scene : scenes){
+    cv::Mat img(2400, 1600, CV_8UC3, fancy::Grey);
+    scene.second(img, Backend::Atlas); // warm the atlas
+    const double stroke = timeUs([&]{ scene.second(img, Backend::Stroke); });
+    const double atlas = timeUs([&]{ scene.second(img, Backend::Atlas); });
+    std::printf("%-22s %12.1f %12.1f %7.2fx\n", scene.first, stroke, atlas, stroke/atlas);
+  }
+}
+
+// A tracker overlay: the same outlined labels every frame, at moving positions
+static void benchLabelCache() {
+  cv::label_cache cache;
+  cv::Mat img(1080, 1920, CV_8UC3, fancy::Grey);
+  int t = 0;
+  const auto frame = [&](cv::label_cache* labels){
+    ++t;
+    for(int i = 0; i < 200; ++i){
+      const cv::Point at(20 + (97*i + 3*t) % 1800, 20 + (53*i + 2*t) % 1000);
+      cv::putTextOutline(img, at, fancy::White, 2, 0.6, 1.1, fancy::Black, 3).labelCache(labels)
+        << "track " << i % 50;
+    }
+  };
+  frame(&cache); // compose
+  const double fresh = timeUs([&]{ frame(nullptr); }, 10);
+  const double cached = timeUs([&]{ frame(&cache); }, 10);
+  std::printf("%-22s %12s %12s %8s\n", "label_cache 200/frame", "fresh (us)", "cached (us)", "speedup");
+  std::printf("%-22s %12.1f %12.1f %7.2fx  (hit rate %.2f)\n", "  outlined", fresh, cached, fresh/cached,
+      cache.stats().hitRate());
+}
+
+// 500 detections a frame, in a handful of class styles: a putText() chain vs one putTextBatch()
+static void benchBatch() {
+  cv::Mat img(1080, 1920, CV_8UC3, fancy::Grey);
+  cv::text_style styles[4];
+  for(int k = 0; k < 4; ++k){
+    styles[k].color = cv::Scalar(60*k, 255 - 60*k, 128);
+    styles[k].thickness = 1;
+    styles[k].fontScale = 0.5;
+  }
+  std::vector<cv::text_label> labels;
+  for(int i = 0; i < 500; ++i)
+    labels.push_back({cv::Point(10 + (97*i) % 1850, 20 + (53*i) % 1040),
+        "obj " + std::to_string(i % 80), styles[i % 4]});
+
+  const double chained = timeUs([&]{
+    for(const auto& l : labels)
+      cv::putText(img, l.origin, l.style.color, l.style.thickness, l.style.fontScale) << l.text;
+  }, 10);
+  const double batched = timeUs([&]{ cv::putTextBatch(img, labels); }, 10);
+  std::printf("%-22s %12s %12s %8s\n", "batch 500 labels", "chain (us)", "batch (us)", "speedup");
+  std::printf("%-22s %12.1f %12.1f %7.2fx\n", "  4 styles", chained, batched, chained/batched);
+}
+
+// Thousands of labels on a 4K frame: serial vs parallel bands, at each thread count
+static void benchBatchBands() {
+  cv::Mat img(2160, 3840, CV_8UC3, fancy::Grey);
+  cv::text_style style;
+  style.fontScale = 0.6;
+  std::vector<cv::text_label> labels;
+  for(int i = 0; i < 4000; ++i)
+    labels.push_back({cv::Point((97*i) % 3800, (53*i) % 2150), "obj " + std::to_string(i % 80), style});
+
+  const int threads = cv::getNumThreads();
+  cv::setNumThreads(1);
+  const double serial = timeUs([&]{ cv::putTextBatch(img, labels); }, 5);
+  std::printf("%-22s %12s %12s %8s\n", "batch 4000 labels 4K", "1 thread", "bands (us)", "speedup");
+  for(int n = 2; n <= threads; n *= 2){
+    cv::setNumThreads(n);
+    const double banded = timeUs([&]{ cv::putTextBatch(img, labels); }, 5);
+    std::printf("  %2d threads %22.1f %12.1f %7.2fx\n", n, serial, banded, serial/banded);
+  }
+  cv::setNumThreads(threads);
+}
+
+// A static HUD of outlined lines: the chains every frame vs flushing their display list
+static void benchDisplayList() {
+  cv::Mat img(1080, 1920, CV_8UC3, fancy::Grey);
+  const auto hud = [&](cv::display_list* list){
+    for(int i = 0; i < 20; ++i)
+      cv::putTextOutline(img, cv::Point(20, 20 + 50*i), fancy::White, 2, 0.8).displayList(list)
+          .backend(cv::image_ostream::Backend::Atlas)
+        << "sensor " << i << ": " << std::setprecision(4) << 3.14159*i << " m/s";
+  };
+  cv::display_list list;
+  hud(&list);
+  const double drawn = timeUs([&]{ hud(nullptr); });
+  const double flushed = timeUs([&]{ list.flush(img); });
+  std::printf("%-22s %12s %12s %8s\n", "display_list 20 lines", "chains (us)", "flush (us)", "speedup");
+  std::printf("%-22s %12.1f %12.1f %7.2fx\n", "  outlined, atlas", drawn, flushed, drawn/flushed);
+}
+
+// The same HUD: flushing its display list vs compositing its text_overlay, simd and scalar
+static void benchOverlay() {
+  cv::Mat img(1080, 1920, CV_8UC3, fancy::Grey);
+  cv::display_list list;
+  for(int i = 0; i < 20; ++i)
+    cv::putTextOutline(cv::noArray(), cv::Point(20, 20 + 50*i), fancy::White, 2, 0.8).displayList(&list)
+      << "sensor " << i << ": " << std::setprecision(4) << 3.14159*i << " m/s";
+  cv::text_overlay overlay(img.size(), img.type());
+  const double built = timeUs([&]{ overlay.build(list); }, 5);
+  const double flushed = timeUs([&]{ list.flush(img); });
+  const double scalar = timeUs([&]{ overlay.compositeScalar(img); });
+  const double simd = timeUs([&]{ overlay.composite(img); });
+  std::printf("%-22s %12s %12s %8s\n", "text_overlay 20 lines", "flush (us)", "overlay (us)", "speedup");
+  std::printf("%-22s %12.1f %12.1f %7.2fx  (scalar %.1f, build %.1f, %zu tiles)\n", "  outlined, stroke",
+      flushed, simd, flushed/simd, scalar, built, overlay.tiles().size());
+}
+
+// 2000 crowded detections on a 4K frame: picking each label's spot, without drawing
+static void benchPlacement() {
+  std::vector<cv::anchored_label> labels;
+  cv::text_style style;
+  style.fontScale = 0.5;
+  for(int i = 0; i < 2000; ++i)
+    labels.push_back({cv::Rect((97*i) % 3780, (53*i) % 2120, 40 + (i % 7)*10, 30 + (i % 5)*10),
+        {cv::Point(), "obj " + std::to_string(i % 80), style}, {}});
+  std::vector<cv::text_label> placed;
+  std::vector<int> chosen;
+  const double us = timeUs([&]{
+    placed.clear();
+    cv::placeLabels(cv::Size(3840, 2160), labels.data(), labels.size(), placed, &chosen);
+  });
+  std::printf("%-22s %12s %12s\n", "placeLabels 2000 4K", "place (us)", "placed");
+  std::printf("%-22s %12.1f %12zu\n", "  5 placements", us, placed.size());
+}
+
+// A scrolled log of 1000 lines, most of them off the frame: drawing it vs only measuring it
+static void benchCulling() {
+  cv::Mat img(720, 1280, CV_8UC3, fancy::Grey);
+  std::string log;
+  for(int i = 0; i < 1000; ++i)
+    log += "[" + std::to_string(i) + "] frame decoded, 3 detections, 12.5 ms\n";
+  const cv::Point at(10, 20 - 960*18);
+  const double drawn = timeUs([&]{ cv::putText(img, at, fancy::Black, 1, 0.5, 1.1) << log; }, 10);
+  const double measured = timeUs([&]{ cv::putText(cv::noArray(), at, fancy::Black, 1, 0.5, 1.1) << log << cv::putText(); }, 10);
+  std::printf("%-22s %12s %12s %8s\n", "log 1000 lines", "measure (us)", "draw (us)", "ratio");
+  std::printf("%-22s %12.1f %12.1f %7.2fx\n", "  most off the frame", measured, drawn, drawn/measured);
+}
+
+// A dashboard of 12 fields where only the clock changes: drawing them all vs text_hud::render()
+static void benchHud() {
+  const cv::Mat panel(1080, 1920, CV_8UC3, fancy::Grey);
+  cv::Mat img = panel.clone();
+  cv::text_hud hud(panel);
+  std::vector<std::string> fields;
+  for(int i = 0; i < 12; ++i){
+    fields.push_back("field " + std::to_string(i) + ": " + std::to_string(1000 + 37*i));
+    hud.slot(fields.back(), cv::Point(20 + 600*(i % 3), 40 + 80*(i / 3)));
+    hud.set(fields.back(), fields.back());
+  }
+  hud.render();
+  int t = 0;
+  const double full = timeUs([&]{
+    ++t;
+    panel.copyTo(img);
+    for(size_t i = 0; i < fields.size(); ++i)
+      cv::putText(img, cv::Point(20 + 600*(i % 3), 40 + 80*(i / 3))) << (i ? fields[i] : std::to_string(t));
+  });
+  const double incremental = timeUs([&]{
+    hud.set(fields[0], std::to_string(++t));
+    hud.render();
+  });
+  std::printf("%-22s %12s %12s %8s\n", "text_hud 12 fields", "full (us)", "render (us)", "speedup");
+  std::printf("%-22s %12.1f %12.1f %7.2fx\n", "  1 changed", full, incremental, full/incremental);
+}
+
+// Numeric readouts, formatted by std::to_chars() vs by the stream: a copy of the classic
+// locale, which formats the same, but isn't classic() and so takes the stream's path
+static void benchNumbers() {
+  const auto readouts = []{
+    for(int i = 0; i < 1000; ++i)
+      cv::putText(cv::noArray(), cv::Point(0, 0)) << "x " << 0.25*(i % 8) << " n " << i % 10
+        << std::fixed << std::setprecision(2) << ' ' << 0.5*(i % 4) << cv::putText();
+  };
+  readouts(); // warm up
+  const double fast = timeUs(readouts, 10);
+  const std::locale classic = std::locale::global(std::locale(std::locale::classic(), new std::numpunct<char>));
+  const double streamed = timeUs(readouts, 10);
+  std::locale::global(classic);
+  std::printf("%-22s %12s %12s %8s\n", "numbers 1000 labels", "stream (us)", "to_chars (us)", "speedup");
+  std::printf("%-22s %12.1f %12.1f %7.2fx\n", "  3 per label", streamed, fast, streamed/fast);
+}
+
+// 1000 outlined and background labels with render_stats off (the default) and on
+static void benchStats() {
+  cv::Mat img(720, 1280, CV_8UC3, fancy::Grey);
+  const auto frame = [&]{
+    for(int i = 0; i < 1000; ++i){
+      const cv::Point at(20 + (i % 20)*62, 20 + (i / 20)*14);
+      if(i % 2) cv::putTextOutline(img, at, fancy::White, 1, 0.4, 1.1, fancy::Black, 2) << "id " << i;
+      else cv::putTextBackground(img, at, fancy::Black, fancy::White, true, 1, 0.4) << "id " << i;
+    }
+  };
+  frame(); // warm the metrics cache
+  const double off = timeUs(frame, 15);
+  cv::render_stats::enable();
+  const double on = timeUs(frame, 15);
+  cv::render_stats::enable(false);
+  std::printf("%-22s %12s %12s %8s\n", "render_stats 1000", "off (us)", "on (us)", "overhead");
+  std::printf("%-22s %12.1f %12.1f %7.1f%%\n", "  outline/background", off, on, (on/off - 1)*100);
+}
+
+// One configuration of the suite: the entry point and the settings it draws its labels with
+struct SuiteCase {
+  const char* entry;
+  cv::HersheyFonts face;
+  double scale;
+  cv::LineTypes lineType;
+  int lines;
+  int imageType;
+  double us; // best of the reps, for all the labels
+};
+
+static const char* faceName(cv::HersheyFonts face) {
+  return face == cv::FONT_HERSHEY_SIMPLEX ? "simplex" : face == cv::FONT_HERSHEY_TRIPLEX ? "triplex" : "other";
+}
+
+static const char* typeName(int type) {
+  return type == CV_8UC1 ? "CV_8UC1" : type == CV_8UC3 ? "CV_8UC3" : type == CV_8UC4 ? "CV_8UC4" : "other";
+}
+
+// Labels of the suite, per frame: a 10x10 grid over 1280x720
+static const int suiteLabels = 100;
+
+// Writes the suite's results to path, as JSON: the run, then one object per case
+static void writeSuiteJson(const char* path, const std::vector<SuiteCase>& cases) {
+  std::FILE* f = std::fopen(path, "w");
+  if(!f){ std::fprintf(stderr, "bench: can't write %s\n", path); return; }
+  std::fprintf(f, "{\n  \"opencv\": \"%s\",\n  \"threads\": %d,\n  \"labels\": %d,\n  \"cases\": [\n",
+      CV_VERSION, cv::getNumThreads(), suiteLabels);
+  for(size_t i = 0; i < cases.size(); ++i){
+    const SuiteCase& c = cases[i];
+    const double ns = c.us*1e3/suiteLabels;
+    std::fprintf(f, "    {\"entry\": \"%s\", \"face\": \"%s\", \"scale\": %g, \"lineType\": \"%s\", "
+        "\"lines\": %d, \"image\": \"%s\", \"ns_per_label\": %.1f, \"labels_per_sec\": %.0f}%s\n",
+        c.entry, faceName(c.face), c.scale, c.lineType == cv::LINE_AA ? "LINE_AA" : "LINE_8",
+        c.lines, typeName(c.imageType), ns, 1e9/ns, i + 1 < cases.size() ? "," : "");
+  }
+  std::fprintf(f, "  ]\n}\n");
+  std::fclose(f);
+}
+
+// Each entry point over faces, scales, line types, line counts and image types, drawing
+// suiteLabels labels a frame, with raw cv::putText (one call per line) as the baseline.
+// Prints each entry's geometric mean over the cases; with json, writes every case there
+static void benchSuite(const char* json) {
+  typedef std::function<void(cv::Mat&, cv::Point, const std::string&, const SuiteCase&)> Draw;
+  const cv::Scalar white = cv::Scalar::all(255);
+  const auto thick = [](const SuiteCase& c){ return c.scale < 1 ? 1 : 2; };
+  const std::vector<std::pair<const char*, Draw>> entries{
+    {"cv::putText", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      // As the streams do, a line at a time, each line_height*1.1 under the last
+      int baseLine = 0;
+      const int height = cv::getTextSize("Ag", c.face, c.scale, thick(c), &baseLine).height;
+      const int step = (int)std::rint((height + baseLine)*1.1);
+      at.y += height;
+      for(size_t start = 0, end; start <= text.size(); start = end + 1, at.y += step){
+        end = std::min(text.find('\n', start), text.size());
+        cv::putText(img, text.substr(start, end - start), at, c.face, c.scale, white, thick(c), c.lineType);
+      }
+    }},
+    {"putText", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putText(img, at, white, thick(c), c.scale, 1.1, c.face, c.lineType) << text;
+    }},
+    {"putTextFancy", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putTextFancy(img, at, fancy::Black, 2, false, std::nullopt, true, true,
+          white, thick(c), c.scale, 1.1, c.face, c.lineType) << text;
+    }},
+    {"putTextOutline", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putTextOutline(img, at, white, thick(c), c.scale, 1.1, fancy::Black, 2, c.face).lineType(c.lineType) << text;
+    }},
+    {"putTextShadow", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putTextShadow(img, at, white, thick(c), c.scale, 1.1, 2, fancy::Black, c.face).lineType(c.lineType) << text;
+    }},
+    {"putTextBackground", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putTextBackground(img, at, fancy::Black, white, true, thick(c), c.scale, true, 1.1, c.face)
+          .lineType(c.lineType) << text;
+    }},
+    {"putText_RelativeTo", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putText_RelativeTo(img, cv::Rect(at, cv::Size(80, 40)), cv::image_ostream::VertAlign::Bottom)
+          .color(white).thickness(thick(c)).fontScale(c.scale).fontFace(c.face).lineType(c.lineType) << text;
+    }},
+    {"putTextFancy_RelativeTo", [&](cv::Mat& img, cv::Point at, const std::string& text, const SuiteCase& c){
+      cv::putTextFancy_RelativeTo(img, cv::Rect(at, cv::Size(80, 40)), cv::image_ostream::VertAlign::Bottom)
+          .outlineColor(fancy::Black).outlineThickness(2)
+          .color(white).thickness(thick(c)).fontScale(c.scale).fontFace(c.face).lineType(c.lineType) << text;
+    }},
+  };
+
+  std::vector<SuiteCase> cases;
+  for(const auto& entry : entries)
+    for(const cv::HersheyFonts face : {cv::FONT_HERSHEY_SIMPLEX, cv::FONT_HERSHEY_TRIPLEX})
+      for(const double scale : {0.5, 1.0})
+        for(const cv::LineTypes lineType : {cv::LINE_8, cv::LINE_AA})
+          for(const int lines : {1, 3})
+            for(const int type : {CV_8UC1, CV_8UC3, CV_8UC4}){
+              SuiteCase c{entry.first, face, scale, lineType, lines, type, 0};
+              cv::Mat img(720, 1280, type, fancy::Grey);
+              std::vector<std::string> texts;
+              for(int i = 0; i < 10; ++i)
+                texts.push_back("car 0." + std::to_string(90 + i) + (lines == 1 ? "" : "\ntrack 1" + std::to_string(i) + "\n(120, 48)"));
+              c.us = timeUs([&]{
+                for(int i = 0; i < suiteLabels; ++i)
+                  entry.second(img, cv::Point(20 + (i % 10)*120, 20 + (i / 10)*68), texts[i % 10], c);
+              }, 3);
+              cases.push_back(c);
+            }
+
+  std::printf("%-26s %13s %14s %9s\n", "suite (geomean)", "ns/label", "labels/sec", "vs raw");
+  double baseline = 0;
+  for(const auto& entry : entries){
+    double logSum = 0;
+    int n = 0;
+    for(const SuiteCase& c : cases)
+      if(c.entry == entry.first){ logSum += std::log(c.us*1e3/suiteLabels); ++n; }
+    const double ns = std::exp(logSum/n);
+    if(!baseline) baseline = ns;
+    std::printf("  %-24s %13.0f %14.0f %8.2fx\n", entry.first, ns, 1e9/ns, ns/baseline);
+  }
+  if(json){
+    writeSuiteJson(json, cases);
+    std::printf("  %zu cases written to %s\n", cases.size(), json);
+  }
+}
+
+// Runs everything; --suite runs only benchSuite(), and --json FILE writes its cases to FILE
+int main(int argc, char** argv) {
+  const char* json = nullptr;
+  bool suiteOnly = false;
+  for(int i = 1; i < argc; ++i){
+    if(!std::strcmp(argv[i], "--json") && i + 1 < argc) json = argv[++i];
+    else if(!std::strcmp(argv[i], "--suite")) suiteOnly = true;
+    else { std::fprintf(stderr, "usage: %s [--suite] [--json FILE]\n", argv[0]); return 2; }
+  }
+  try {
+    if(suiteOnly){
+      benchSuite(json);
+      return 0;
+    }
+    benchMaskBlend();
+    benchNumbers();
+    benchOutline();
+    benchLabelCache();
+    benchBatch();
+    benchBatchBands();
+    benchDisplayList();
+    benchOverlay();
+    benchHud();
+    benchPlacement();
+    benchCulling();
+    benchStats();
+    benchSuite(json);
+  } catch(const cv::Exception& e) {
+    std::cerr << "CV:Exception: " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// bench.cpp
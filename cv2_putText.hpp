@@ -85,7 +85,28 @@ cv::putText(image2, cv::Point(100,100), Scalar(i, i, 255))
 */
 
 #include <opencv2/core.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 namespace cv {
@@ -102,6 +123,7 @@ namespace cv {
   X(bool, bottomLeftOrigin, false) \
   X(image_ostream::TextAlign, align, image_ostream::TextAlign::Left) \
   X(bool, reverse, false) \
+  X(image_ostream::Backend, backend, image_ostream::Backend::Stroke) \
 
 #define CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_RESULT_X \
   X(cv::Size, TextSize) \
@@ -109,6 +131,506 @@ namespace cv {
   X(cv::Rect, Textbox) \
   X(cv::Point, Origin)
 
+//! Per-font Hershey glyph advances, derived once per font face from cv::getTextSize().
+//! Measuring a line is then a sum over its bytes, with the same arithmetic (and so the
+//! same result) as cv::getTextSize(). The one case handled by falling back to
+//! cv::getTextSize() is FONT_HERSHEY_COMPLEX with bytes >= 0x80, which it reads as UTF-8.
+class CV_EXPORTS hershey_metrics
+{
+public:
+    //! Tables for fontFace (optionally | FONT_ITALIC), built on first use.
+    //! nullptr if fontFace isn't a Hershey font.
+    static const hershey_metrics* get(int fontFace);
+
+    //! Same contract as cv::getTextSize() for this font
+    Size getTextSize(const std::string& text, double fontScale, int thickness, int* baseLine) const;
+    //! Whether getTextSize() sums text from the tables; false (it calls cv::getTextSize()) for
+    //! FONT_HERSHEY_COMPLEX with bytes >= 0x80
+    bool summable(const std::string& text) const;
+
+    //! Unscaled advance of byte c; bytes cv::putText can't draw advance like '?'
+    int advance(uchar c) const { return _advance[c]; }
+    //! Unscaled cap + base line height, and base line
+    int height() const { return _height; }
+    int baseLine() const { return _baseLine; }
+    int fontFace() const { return _fontFace; }
+
+    //! How far, in font units, strokes reach past a line's getTextSize() box, on each side
+    struct Reach { int left, top, right, bottom; };
+    //! text's reach: the font's glyphs', measured once from cv::putText() strokes. 16 units every
+    //! way for FONT_HERSHEY_COMPLEX with bytes >= 0x80, whose glyphs aren't measured
+    Reach reach(const std::string& text) const;
+
+protected:
+    explicit hershey_metrics(int fontFace);
+
+    int _fontFace;
+    int _height;
+    int _baseLine;
+    int _advance[256];
+    Reach _reach;
+};
+
+//! Bounded, thread-safe memo of cv::getTextSize() results.
+//! Keyed on (text, fontFace, fontScale, thickness); least recently used entries are evicted
+//! once capacity is reached. Hershey lines shorter than directLength bytes skip the memo, as
+//! summing them from hershey_metrics costs less than a lookup. Each thread's global() instance
+//! measures the lines of every text_layout on it, and thereby also the TextSize/LineSizes/Textbox
+//! results; their capacity is set for every thread at once with setGlobalCapacity().
+class CV_EXPORTS text_metrics_cache
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t direct = 0; // short Hershey lines, summed without a lookup
+        size_t entries = 0;
+        size_t capacity = 0;
+    };
+
+    //! Hershey lines shorter than this are summed on every call; longer lines, where a lookup
+    //! costs less than the sum, and other fonts are memoized
+    static constexpr size_t directLength = 64;
+
+    explicit text_metrics_cache(size_t capacity = 1024);
+
+    //! Same contract as cv::getTextSize(); identical size and baseline
+    Size getTextSize(const std::string& text, int fontFace, double fontScale, int thickness, int* baseLine);
+
+    Stats stats() const;
+    void resetStats();
+    void clear();
+    //! Capacity of 0 disables memoization (every lookup is a miss). On a global() cache, only the
+    //! calling thread's, until the next setGlobalCapacity()
+    void setCapacity(size_t capacity);
+
+    //! The calling thread's cache, used by every image_ostream/image_ostream_fancy on it; per
+    //! thread, so streams annotating on different threads never contend for it. Its stats() are
+    //! this thread's
+    static text_metrics_cache& global();
+    //! Capacity of every thread's global() cache (1024 by default), existing and future; each
+    //! takes it on its next use. 0 disables memoization
+    static void setGlobalCapacity(size_t capacity);
+    static size_t globalCapacity();
+
+protected:
+    struct Entry
+    {
+        size_t hash;
+        std::string text;
+        int fontFace;
+        double fontScale;
+        int thickness;
+        Size size;
+        int baseLine;
+    };
+    typedef std::list<Entry>::iterator EntryIt;
+
+    static size_t _hash(const std::string& text, int fontFace, double fontScale, int thickness);
+    static Size _measure(const hershey_metrics* glyphs, const std::string& text, int fontFace,
+                         double fontScale, int thickness, int* baseLine);
+    EntryIt _find(size_t hash, const std::string& text, int fontFace, double fontScale, int thickness);
+    void _evict(size_t capacity);
+
+    mutable std::mutex _mutex;
+    size_t _capacity;
+    std::list<Entry> _lru; // front is most recently used
+    // Hashed on the key so lookups don't need to copy the text
+    std::unordered_multimap<size_t, EntryIt> _index;
+    std::atomic<size_t> _hits;
+    std::atomic<size_t> _misses;
+    std::atomic<size_t> _direct;
+    size_t _globalCapacity; // of a global() cache: the setGlobalCapacity() it last took
+
+    static std::atomic<size_t> _capacityForAll;
+};
+
+#define CV2_PUTTEXT_HPP__RENDER_STATS_X \
+  X(textSizeCalls) \
+  X(putTextCalls) \
+  X(lines) \
+  X(chars) \
+  X(backgrounds) \
+  X(boundsArea) \
+  X(measureTicks) \
+  X(backgroundTicks) \
+  X(outlineTicks) \
+  X(textTicks)
+
+//! Opt-in counters of the rendering internals, for metrics exporters. Each thread counts into
+//! its own slot, without locks; snapshot() sums every thread's (those exited too) on demand.
+//! Disabled (the default), each counting point costs a relaxed load and a branch.
+class CV_EXPORTS render_stats
+{
+public:
+    //! textSizeCalls: cv::getTextSize() calls measuring text (the font tables measure the rest)
+    //! putTextCalls: cv::putText() calls drawing lines (Backend::Stroke, and atlas fallbacks)
+    //! lines, chars: lines of text drawn (an outlined line once), and their characters
+    //! backgrounds: background rectangles drawn
+    //! boundsArea: the area of each draw's bounds (display_list::bounds()) within the image; an
+    //! upper bound on the pixels drawn, not a count of them
+    //! measureTicks: time laying out lines; backgroundTicks, outlineTicks, textTicks: drawing
+    //! them (the atlas draws an outline and its text in one pass, counted as outline). In
+    //! cv::getTickCount() ticks; seconds() converts
+    struct Counters
+    {
+#define X(name) int64_t name = 0;
+        CV2_PUTTEXT_HPP__RENDER_STATS_X
+#undef X
+    };
+    enum class Counter : int
+    {
+#define X(name) name,
+        CV2_PUTTEXT_HPP__RENDER_STATS_X
+#undef X
+    };
+
+    static void enable(bool on = true) { _enabled.store(on, std::memory_order_relaxed); }
+    static bool enabled() { return _enabled.load(std::memory_order_relaxed); }
+    //! Every thread's counts, since the last reset()
+    static Counters snapshot();
+    static void reset();
+    static double seconds(int64_t ticks) { return ticks/cv::getTickFrequency(); }
+
+    //! Adds n to this thread's counter, when enabled
+    static void add(Counter counter, int64_t n = 1)
+    {
+        if(!enabled()) return;
+        std::atomic<int64_t>& value = _local()[(int)counter];
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    //! Adds its lifetime to a phase's ticks, when enabled
+    class Timer
+    {
+    public:
+        explicit Timer(Counter phase) : _phase(phase), _t0(enabled() ? cv::getTickCount() : 0) {}
+        ~Timer() { if(_t0) add(_phase, cv::getTickCount() - _t0); }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+    private:
+        const Counter _phase;
+        const int64_t _t0;
+    };
+
+protected:
+    static const int _count = 0
+#define X(name) + 1
+        CV2_PUTTEXT_HPP__RENDER_STATS_X
+#undef X
+        ;
+    struct _Slot;
+    struct _Registry;
+    // This thread's counters, registered on first use; written only by this thread
+    static std::atomic<int64_t>* _local();
+    static _Registry& _registry();
+    // The counts of every thread, and of those exited, not less the baseline
+    static void _sum(int64_t* values);
+    static std::atomic<bool> _enabled;
+};
+
+#ifdef CV2_PUTTEXT_TRACE
+//! In-memory ring buffer of per-label render spans, for latency investigations: each text block
+//! drawn (or measured) by an image_ostream or image_ostream_fancy is a begin/end pair, with its
+//! length, style and Textbox. Dumped as Chrome trace-event JSON, for chrome://tracing or
+//! Perfetto. Only with CV2_PUTTEXT_TRACE defined (in every file including this header);
+//! without, the hooks aren't compiled at all
+class CV_EXPORTS trace_buffer
+{
+public:
+    enum Decoration : unsigned { Outline = 1, Shadow = 2, Background = 4 };
+    struct Event
+    {
+        char phase = 'B';         // 'B'egin or 'E'nd of the span
+        int64_t ticks = 0;        // cv::getTickCount()
+        uint32_t thread = 0;      // numbered in order of first trace
+        uint32_t chars = 0;       // the block's length, in bytes
+        uint32_t lines = 0;
+        int fontFace = 0;
+        double fontScale = 0;
+        int thickness = 0;
+        unsigned decorations = 0; // of Decoration
+        Rect box;                 // the Textbox; on 'E' only
+        char text[24] = {};       // the block's start, whole UTF-8 code points, NUL-terminated
+    };
+
+    //! Events kept (65536 by default), the oldest overwritten first; drops those kept
+    static void setCapacity(size_t events);
+    static void clear();
+    //! Oldest first
+    static std::vector<Event> events();
+    //! {"traceEvents": [...]}, with timestamps in microseconds
+    static std::string chromeJson();
+    static bool writeChromeJson(const std::string& path);
+
+    static void record(const Event& event);
+
+protected:
+    static std::mutex _mutex;
+    static std::vector<Event> _ring;
+    static size_t _capacity;
+    static size_t _next;  // where the next event goes
+    static size_t _count;
+};
+#endif
+
+//! Solid-color compositing through an 8-bit coverage mask, for blitting text masks:
+//! dst = (dst*(255 - mask) + color*mask)/255, rounded, so 0 keeps the pixel and 255 writes
+//! color exactly. CV_8UC1, CV_8UC3 and CV_8UC4 images are blended with OpenCV universal
+//! intrinsics when the build has them; other types take Mat::setTo() where mask is non-zero.
+//! The *Scalar() variants are the plain-C++ reference the vector kernels must match.
+class CV_EXPORTS mask_blend
+{
+public:
+    //! img and mask (CV_8UC1) must be the same size; either may be a ROI
+    static void blend(InputOutputArray img, InputArray mask, const Scalar& color);
+    static void blendScalar(InputOutputArray img, InputArray mask, const Scalar& color);
+
+    //! One row of width pixels with cn (1, 3 or 4) interleaved channels; color holds cn bytes
+    static void blendRow(uchar* dst, const uchar* mask, int width, int cn, const uchar* color);
+    static void blendRowScalar(uchar* dst, const uchar* mask, int width, int cn, const uchar* color);
+
+protected:
+    template<int cn> static int _blendRowSimd(uchar* dst, const uchar* mask, int width, const uchar* color);
+    static void _blend(InputOutputArray img, InputArray mask, const Scalar& color, bool simd);
+};
+
+//! Alpha-mask glyph cache for one (fontFace, fontScale, thickness, lineType) rendering of the
+//! Hershey fonts. cv::putText() places each glyph at a 16.16 fixed-point pen position, so a
+//! glyph is stroked once per (character, sub-pixel phase) into an atlas page, and later draws
+//! copy those masks instead of re-stroking the polylines.
+//! Only the binary line types (LINE_4, LINE_8) are cached: their output is exactly the union
+//! of the glyph masks. LINE_AA blends overlapping strokes, so it stays on cv::putText().
+class CV_EXPORTS glyph_atlas
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;       // glyph lookups served from the atlas
+        size_t misses = 0;     // glyphs stroked into the atlas
+        size_t glyphs = 0;
+        size_t pages = 0;
+        size_t bytes = 0;
+        size_t fallbacks = 0;  // lines left to cv::putText()
+        size_t mismatches = 0; // Debug::verify_backend lines that differed from cv::putText()
+        size_t evictions = 0;  // times emptied to keep every atlas within globalByteBudget()
+    };
+
+    //! Shared atlas for this rendering; nullptr if it can't be reproduced from masks
+    static glyph_atlas* get(int fontFace, double fontScale, int thickness, int lineType);
+
+    //! Draws like cv::putText(img, text, org, fontFace, fontScale, color, thickness, lineType, false).
+    //! Returns false, having drawn nothing, when the line can't be reproduced exactly:
+    //! it comes within a pixel of the image border, or has UTF-8 for FONT_HERSHEY_COMPLEX.
+    bool drawText(InputOutputArray img, const std::string& text, Point org, const Scalar& color);
+    //! As drawText(), but also strokes the line with cv::putText() and compares the two.
+    //! The image keeps the cv::putText() pixels; differences are counted in Stats::mismatches.
+    bool verifyText(InputOutputArray img, const std::string& text, Point org, const Scalar& color);
+
+    //! One line of a drawLayers() stack, like an outline under its text
+    struct Layer
+    {
+        glyph_atlas* atlas;
+        const std::string& text;
+        Point org;
+        Scalar color;
+    };
+    //! Draws the layers bottom to top in a single pass: their masks are resolved into one label
+    //! map, then each covered pixel is written once, with the color of the topmost layer on it.
+    //! Same pixels as drawText() of each layer in turn; false, having drawn nothing, if any
+    //! layer would fall back.
+    static bool drawLayers(InputOutputArray img, const std::vector<Layer>& layers);
+    //! As drawLayers(), checked against cv::putText() of each layer like verifyText().
+    //! Differences are counted in the top layer's Stats::mismatches.
+    static bool verifyLayers(InputOutputArray img, const std::vector<Layer>& layers);
+
+    Stats stats() const;
+    //! Sum over every atlas, of every thread (hits, misses, fallbacks and mismatches include
+    //! those of exited threads)
+    static Stats globalStats();
+    //! Drops every cached glyph, of every thread (stats are kept)
+    static void clearAll();
+    //! Bytes of glyphs every atlas, of every thread, may hold together (64 MB by default; each
+    //! holds at most 8 MB). Past it, the least recently used atlases are emptied, whole, until
+    //! the rest fit; 0 for no limit
+    static void setGlobalByteBudget(size_t bytes);
+    static size_t globalByteBudget();
+
+protected:
+    glyph_atlas(const hershey_metrics* metrics, double fontScale, int thickness, int lineType);
+
+    struct Glyph
+    {
+        Mat mask;     // empty for blank glyphs, like ' '
+        Point offset; // of the mask, from the pen's integer position on the line's origin row
+        bool valid;   // false if it couldn't be isolated; lines using it fall back
+    };
+    struct Placement
+    {
+        Mat mask;
+        Point tl;
+    };
+
+    // Finds the glyphs of text, stroking missing ones; false if the line must fall back
+    bool _layout(const std::string& text, Point org, Size imgSize, std::vector<Placement>& placed);
+    // c at the pen after glyphs of unscaled advance sum advance; stroked on a miss
+    const Glyph& _glyph(uchar c, int64_t advance);
+    Mat _allocate(Size size);
+    void _clear();
+    // Empties the least recently used atlases, of any thread, until all fit the budget
+    static void _evict();
+
+    // Each thread has its own atlases, so threads drawing the same font never share glyph
+    // pages, or wait on each other; their mutexes are only contended by globalStats() and clearAll()
+    struct Registry
+    {
+        typedef std::tuple<int, double, int, int> Key; // fontFace, fontScale, thickness, lineType
+        std::mutex mutex;
+        std::map<Key, std::unique_ptr<glyph_atlas>> atlases;
+        Registry();
+        ~Registry();
+    };
+    // Every thread's registry, and the counts of those exited
+    struct Threads
+    {
+        std::mutex mutex;
+        std::vector<Registry*> registries;
+        Stats exited;
+        std::atomic<size_t> bytes{0}; // of every atlas
+        std::atomic<size_t> budget{64 << 20};
+        std::atomic<uint64_t> clock{0}; // ticks on every allocation, of any atlas
+    };
+    static Registry& _registry(); // the calling thread's
+    static Threads& _threads();
+    static void _add(Stats& sum, const Stats& s);
+
+    const hershey_metrics* _metrics;
+    const double _fontScale;
+    const int _thickness;
+    const int _lineType;
+    const int _hscale; // fontScale in 16.16 fixed-point, as cv::putText() rounds it
+
+    mutable std::mutex _mutex;
+    std::atomic<uint64_t> _used{0}; // Threads::clock when last drawn with
+    std::unordered_map<uint32_t, Glyph> _glyphs; // (character << 16) | phase
+    const int _period; // advance sums this many font units apart put the pen at the same phase
+    std::vector<Mat> _pages;
+    Point _shelf;      // next free spot on the last page
+    int _shelfHeight;
+    Stats _stats;
+};
+
+//! The text buffer of an image_ostream: a std::streambuf writing into inline storage, moving to
+//! the heap only once a text outgrows it (and keeping that capacity when cleared).
+//! Read back as a std::string_view, so lines can be split without copying them.
+class CV_EXPORTS text_buffer : public std::streambuf
+{
+public:
+    static const size_t kInlineSize = 128;
+
+    text_buffer() { setp(_inline, _inline + kInlineSize); }
+    //! Copies the text
+    text_buffer(const text_buffer& rhs) : text_buffer() { append(rhs.view()); }
+    //! Takes the text (and any heap storage), leaving rhs empty
+    text_buffer(text_buffer&& rhs) noexcept;
+    text_buffer& operator=(const text_buffer&) = delete;
+
+    void append(std::string_view text);
+    void append(char c)
+    {
+        if(pptr() == epptr()) _reserve(1);
+        *pptr() = c;
+        pbump(1);
+    }
+    void assign(std::string_view text) { clear(); append(text); }
+    void clear() { setp(pbase(), epptr()); }
+
+    std::string_view view() const { return std::string_view(pbase(), size()); }
+    char* data() { return pbase(); }
+    size_t size() const { return (size_t)(pptr() - pbase()); }
+    bool empty() const { return pptr() == pbase(); }
+    //! Whether the text has outgrown the inline storage
+    bool spilled() const { return (bool)_heap; }
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    // Makes room for extra more bytes past the text
+    void _reserve(size_t extra);
+
+    char _inline[kInlineSize];
+    std::unique_ptr<char[]> _heap;
+};
+
+//! Where the lines of a text block go, resolved from the text and its settings alone: no image
+//! is touched. A stream lays out its text, then draws the lines of the layout, so
+//! image_ostream::layout() gives the same positions and results as drawing, without drawing.
+//! A layout is a plain value: it can be kept, and drawn line by line with cv::putText().
+struct CV_EXPORTS text_layout
+{
+    struct Line
+    {
+        std::string text; // tabs expanded
+        Point at;         // the aligned end of the line, at its offset from the origin
+        Point org;        // of the text, as cv::putText(..., bottomLeftOrigin=false)
+        Size size;        // as cv::getTextSize(), but 0 wide for an empty line
+        int baseLine;
+        int advance;      // to the next line; negative when reversed
+    };
+    std::vector<Line> lines;
+    //! The TextSize, Textbox and Origin results; the height is the offset past the last line,
+    //! from the origin of the stream (so it includes lines it already drew)
+    Size textSize;
+    Rect textbox;
+    Point origin;
+
+    //! The LineSizes result: (width, advance) of each line
+    std::vector<Size> lineSizes() const;
+};
+
+//! The parts of an image that drawing changed, for partial texture uploads or ROI-only encoding.
+//! Streams given .damage(&region) add the exact bounds of the pixels each draw changed (text,
+//! outline, shadow, background, markers): the draw's box from the line metrics is copied first,
+//! and compared after, so ink drawn over the same color adds nothing. Rectangles that overlap or
+//! touch are merged, and past maxRects the pair costing the least extra area is merged, so the
+//! region stays a handful of disjoint rectangles. Not thread-safe.
+class CV_EXPORTS damage_region
+{
+public:
+    explicit damage_region(size_t maxRects = 8) : _maxRects(std::max<size_t>(maxRects, 1)) {}
+
+    void add(const Rect& rect);
+    //! Adds the bounds of the pixels where after differs from before, same-sized views of the
+    //! image at offset
+    void addChanged(const Mat& before, const Mat& after, Point offset);
+    //! Calls draw(), which changes nothing in img outside box, and adds the pixels it changed
+    template <typename Draw>
+    void track(const Mat& img, Rect box, Draw&& draw)
+    {
+        box &= Rect(Point(0, 0), img.size());
+        if(box.empty()) return draw();
+        img(box).copyTo(_before);
+        draw();
+        addChanged(_before, img(box), box.tl());
+    }
+    void clear() { _rects.clear(); }
+    bool empty() const { return _rects.empty(); }
+    const std::vector<Rect>& rects() const { return _rects; }
+    //! The smallest rectangle holding the whole region
+    Rect bounds() const;
+    //! Pixels in the region
+    size_t area() const;
+
+protected:
+    static bool _touch(const Rect& a, const Rect& b);
+
+    size_t _maxRects;
+    std::vector<Rect> _rects;
+    Mat _before; // track()'s copy, kept for its buffer
+};
+
+class display_list;
+
 //! Creates and return image_ostream object to render text on the image like the std::cout does.
 //! An image_ostream class supports operator<< for both primitive and opencv types.
 struct CV_EXPORTS image_ostream
@@ -116,6 +638,9 @@ struct CV_EXPORTS image_ostream
 
     enum class TextAlign : unsigned { Left, Right, Center };
     enum class VertAlign : unsigned { Top, Bottom, Mid };
+    //! Stroke: cv::putText() strokes the Hershey polylines every draw
+    //! Atlas: glyph_atlas masks, stroked once; same pixels, falls back to Stroke when it can't
+    enum class Backend : unsigned { Stroke, Atlas };
 
     image_ostream(
         InputOutputArray img, Point origin,
@@ -127,21 +652,32 @@ struct CV_EXPORTS image_ostream
 #undef X
         void*_=0);
 
-    //! Copy constructor is necessary because compiler cannot perform RVO in putText() function in some cases. To deal with it we introduce copy
-    //! constructor which copies image_ostream object and it's internal string buffer.
+    //! Copies the settings and the pending text; both copies will draw it
     image_ostream(const image_ostream&);
+    //! Takes the settings, pending text, formatting and result pointers. rhs is left without an
+    //! image, display list or text, so it draws nothing: returning or wrapping a stream draws once.
+    image_ostream(image_ostream&&);
 
     //! Prints everything to the cv::Mat in the destructor
     ~image_ostream();
 
-    //! Self operator<< to chain multiple settings
-    image_ostream& operator<<(const image_ostream& new_settings);
+    //! Self operator<< to chain multiple settings. Only for an image_ostream itself: fancy settings
+    //! are taken by the operator<< of cv2_putText_fancy.hpp, which continues as a fancy stream
+    template <typename T, std::enable_if_t<std::is_same_v<T, image_ostream>, int> = 0>
+    image_ostream& operator<<(const T& new_settings)
+    {
+        // First, dump out the old string, with old format
+        _nextLine();
+        // Then, copy over the new settings
+        _applySettings(new_settings);
+        return *this;
+    }
 
     //! Defalt operator<< to take everything
-    template <typename T>
+    template <typename T, std::enable_if_t<!std::is_base_of_v<image_ostream, T>, int> = 0>
     image_ostream& operator<<(const T& x)
     {
-        _str << x;
+        _insert(x);
         return *this;
     }
 
@@ -154,7 +690,7 @@ struct CV_EXPORTS image_ostream
     //! Define an operator<< to take in std::endl and other manipulators
     inline image_ostream& operator<<(ManipType manip)
     {
-        manip(_str);
+        _insert(manip);
         return *this;
     }
 
@@ -171,29 +707,234 @@ struct CV_EXPORTS image_ostream
 #define X(type, name, default_val) inline image_ostream& name(std::optional<type> const x){ _##name##_opt = x; return *this; }
     CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
 #undef X
+    //! Record the draws into list instead of drawing them (any image is ignored); see display_list
+    inline image_ostream& displayList(display_list* const list){ _displayList = list; return *this; }
+    //! Add the bounds of the pixels drawing changes to region; see damage_region
+    inline image_ostream& damage(damage_region* const region){ _damage = region; return *this; }
 
+    //! Lays out the pending text, as it would be drawn next, without drawing or consuming it
+    text_layout layout() const { return _layout(_thickness); }
+    //! The Textbox of a block of lines at origin: width of the widest line, and the offset past
+    //! the last line (negative when reversed); oneline for a single line
+    static Rect textbox(Point origin, TextAlign align, bool bottomLeftOrigin, bool oneline, int width, int offset);
+
+    //! One draw of a line (or its background), with its layout resolved; see display_list
+    struct Command
+    {
+        enum class Kind : unsigned { Text, OutlinedText, Rectangle, Marker };
+        Kind kind = Kind::Text;
+        std::string text;
+        Point org;      // of the text, as cv::putText(..., bottomLeftOrigin=false); a corner; the marker
+        Point org2;     // OutlinedText: of the outline (or shadow); Rectangle: the opposite corner
+        Scalar color;
+        Scalar color2;  // OutlinedText: of the outline
+        int thickness = 1;
+        int thickness2 = 1; // OutlinedText: of the outline
+        int fontFace = cv::FONT_HERSHEY_SIMPLEX;
+        double fontScale = 1.0;
+        int lineType = cv::LINE_8;
+        Backend backend = Backend::Stroke;
+
+        bool operator==(const Command& rhs) const
+        {
+            return kind == rhs.kind && text == rhs.text && org == rhs.org && org2 == rhs.org2
+                && color == rhs.color && color2 == rhs.color2
+                && thickness == rhs.thickness && thickness2 == rhs.thickness2
+                && fontFace == rhs.fontFace && fontScale == rhs.fontScale
+                && lineType == rhs.lineType && backend == rhs.backend;
+        }
+        bool operator!=(const Command& rhs) const { return !(*this == rhs); }
+    };
+
+    //! Atomic, so it may be set while other threads draw
     struct Debug
     {
-        bool draw_origin = false;
+        std::atomic<bool> draw_origin{false};
+        //! Check every table-based measurement against cv::getTextSize()
+        std::atomic<bool> verify_metrics{false};
+        //! Draw Backend::Atlas lines with cv::putText() too, and count any pixel mismatches
+        std::atomic<bool> verify_backend{false};
     };
     static Debug _Debug;
 
 protected:
-    // Does not handle newlines!
-    cv::Size _getLineSize(const std::string& text, int& baseline) const
+    cv::Point origin(int x, int y) const { return _origin + cv::Point(x, y); }
+    // The formatting stream over _buf, made on the first insertion that needs it
+    CoutType& _ostream()
     {
-        return cv::getTextSize(text, _fontFace, _fontScale, _thickness, &baseline);
+        if(!_stream) _stream.emplace(&_buf);
+        return *_stream;
     }
-    cv::Point origin(int x, int y) const { return _origin + cv::Point(x, y); }
+    // Until something has been formatted (so no width, fill or flags can be pending),
+    // text and std::endl are appended as is; anything else goes through _ostream()
+    template <typename T>
+    void _insert(const T& x)
+    {
+        typedef std::decay_t<T> D;
+        if constexpr(std::is_same_v<D, std::string> || std::is_same_v<D, std::string_view>)
+        {
+            if(!_stream) return _buf.append(std::string_view(x));
+        }
+        else if constexpr(std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>)
+        {
+            if(!_stream) return _buf.append(std::string_view(x));
+        }
+        else if constexpr(std::is_same_v<D, char*> || std::is_same_v<D, const char*>)
+        {
+            if(!_stream && x) return _buf.append(std::string_view(x));
+        }
+        else if constexpr(std::is_same_v<D, char>)
+        {
+            if(!_stream) return _buf.append(x);
+        }
+        else if constexpr(_isNumber<D>())
+        {
+            if(_appendNumber(x)) return;
+        }
+        _ostream() << x;
+    }
+    // Arithmetic types the stream formats as numbers; character types and bool it doesn't
+    template<typename D>
+    static constexpr bool _isNumber()
+    {
+        return (std::is_integral_v<D> || std::is_floating_point_v<D>) && !std::is_same_v<D, bool>
+            && !std::is_same_v<D, char> && !std::is_same_v<D, signed char> && !std::is_same_v<D, unsigned char>
+            && !std::is_same_v<D, wchar_t> && !std::is_same_v<D, char16_t> && !std::is_same_v<D, char32_t>;
+    }
+    // Formats x with std::to_chars(), when that's byte for byte what the stream would write:
+    // the classic locale, no width, sign, point or case flags, and decimal integers or
+    // %g/%f/%e floating point (by std::fixed, std::scientific, and std::setprecision).
+    // Otherwise returns false, leaving x to the stream.
+    template<typename D>
+    bool _appendNumber(D x)
+    {
+        typedef std::ios_base ios;
+        const ios::fmtflags flags = _stream ? _stream->flags() : ios::dec;
+        if(_stream && _stream->width() != 0) return false;
+        if(flags & (ios::showpos | ios::showpoint | ios::uppercase | ios::showbase)) return false;
+        if(!((_stream ? _stream->getloc() : std::locale()) == std::locale::classic())) return false;
+
+        char text[128];
+        std::to_chars_result result;
+        if constexpr(std::is_integral_v<D>)
+        {
+            const ios::fmtflags base = flags & ios::basefield;
+            if(base != ios::dec && base != ios::fmtflags()) return false;
+            result = std::to_chars(text, text + sizeof(text), x);
+        }
+        else
+        {
+#if defined(__cpp_lib_to_chars)
+            const std::streamsize precision = _stream ? _stream->precision() : 6;
+            // Past 1000 digits, only %g can fit text, where they're all trailing zeros anyway
+            const int digits = precision < 0 ? 6 : (int)std::min<std::streamsize>(precision, 1000);
+            const ios::fmtflags field = flags & ios::floatfield;
+            std::chars_format format = std::chars_format::general;
+            if(field == ios::fixed) format = std::chars_format::fixed;
+            else if(field == ios::scientific) format = std::chars_format::scientific;
+            else if(field != ios::fmtflags()) return false; // hexfloat
+            result = std::to_chars(text, text + sizeof(text), x, format, digits);
+#else
+            return false; // no floating point std::to_chars() in this standard library
+#endif
+        }
+        if(result.ec != std::errc()) return false; // too long; the stream has room
+        _buf.append(std::string_view(text, (size_t)(result.ptr - text)));
+        return true;
+    }
+    void _insert(ManipType manip)
+    {
+        if(!_stream && manip == static_cast<ManipType>(std::endl)) return _buf.append('\n');
+        manip(_ostream());
+    }
+    // Appends text, as if inserted
+    void _append(std::string_view text)
+    {
+        if(_stream) *_stream << text;
+        else _buf.append(text);
+    }
+    // Draws one line, as cv::putText(..., bottomLeftOrigin=false), with the chosen backend
+    void _putText(const std::string& line, cv::Point org, const cv::Scalar& color, int thickness, Backend backend);
+    // Draws the command (adding its bounds to _damage), or records it into _displayList
+    void _draw(Command&& command);
+    // Debug::draw_origin
+    void _drawMarker()
+    {
+        Command command;
+        command.kind = Command::Kind::Marker;
+        command.org = _origin;
+        command.color = cv::Scalar(0, 0, 255);
+        _draw(std::move(command));
+    }
+    // Whether lines are drawn (or recorded); without, they're only measured
+    bool _drawing() const { return !_img.empty() || _displayList; }
     void _nextLine();
-    void _reverseLines();
+    // Ends the pending text: the block render() returns, drawn (or measured), sets the results
+    template<typename Render>
+    void _nextLineWith(Render&& render) { _nextLineWith(std::forward<Render>(render), []{ return 0u; }); }
+    // decorations() returns what's drawn besides the text (trace_buffer::Decoration bits), for
+    // tracing; only called with CV2_PUTTEXT_TRACE
+    template<typename Render, typename Decorations>
+    void _nextLineWith(Render&& render, [[maybe_unused]] Decorations&& decorations)
+    {
+        if(_buf.empty()){ return; }
+        if(_Debug.draw_origin && _drawing()) _drawMarker();
+#ifdef CV2_PUTTEXT_TRACE
+        const unsigned drawn = decorations();
+        _trace('B', drawn, Rect());
+#endif
+        const text_layout block = render();
+#ifdef CV2_PUTTEXT_TRACE
+        _trace('E', drawn, block.textbox);
+#endif
+        _buf.clear();
+        if(_stream) _stream->clear();
+        _setResults(block);
+    }
+#ifdef CV2_PUTTEXT_TRACE
+    // Records the pending text's span to trace_buffer
+    void _trace(char phase, unsigned decorations, const Rect& box) const;
+#endif
+    // Lays out the pending text, measured at thickness, and draws each line with the passes, in
+    // order, each over the ones before: callables of (const text_layout::Line&).
+    // Records LineSizes and advances _offset; without an image (or display list), only measures.
+    // The passes are inlined, so a stream pays only for the ones it's given
+    template<typename... Passes>
+    text_layout _renderLines(int thickness, Passes&&... passes)
+    {
+        const text_layout block = _layoutLines(thickness, [&](const text_layout::Line& line)
+        {
+            if(_pLineSizes) _pLineSizes->emplace_back(line.size.width, line.advance);
+            if(line.text.empty() || !_drawing()) return;
+            (passes(line), ...);
+        });
+        _offset = block.textSize.height;
+        return block;
+    }
+    // The plain text pass: the line in _color, at _thickness
+    auto _textPass(Backend backend)
+    {
+        return [this, backend](const text_layout::Line& line){ _putText(line.text, line.org, _color, _thickness, backend); };
+    }
+    // Lays out the pending text from _offset, measuring lines at thickness. Calls
+    // visit(const text_layout::Line&) on each line, in drawing order; returns the block, no lines.
+    template<typename Visit>
+    text_layout _layoutLines(int thickness, Visit&& visit) const;
+    // With the lines
+    text_layout _layout(int thickness) const;
+    // The results of a block with its widest line, ending at offset
+    text_layout _layoutBlock(int max_width, int offset, bool oneline) const;
+    // Sets the TextSize, Textbox and Origin results (not LineSizes, which are set per line)
+    void _setResults(const text_layout& block);
+    // The settings half of operator<<(new_settings): takes its format, display list and text
+    void _applySettings(const image_ostream& new_settings);
     static void replaceAll(std::string& str, const std::string& from, const std::string& to);
 
 protected:
     // Note: typedef const _InputOutputArray& cv::InputOutputArray
     _InputOutputArray _img; // !!! Can't use InputOutputArray bc doesn't own the temporary!
 public:
-    const Point _origin;
+    Point _origin;
 #define X(type, name, default_val) type _##name;
     CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
 #undef X
@@ -204,9 +945,98 @@ public:
     cv::Size*              _pTextSize;
     cv::Rect*              _pTextbox;
     cv::Point*             _pOrigin;
+    display_list*          _displayList;
+    damage_region*         _damage;
 protected:
     int               _offset;
-    std::stringstream _str;
+    text_buffer       _buf;
+    std::optional<CoutType> _stream; // formatting state, over _buf
+};
+
+//! Retained list of text draws, for a predictable draw point and for overlays that don't change
+//! every frame. A stream given .displayList(&list) records each of its lines as a Command, with
+//! the layout resolved (measured, aligned, at absolute positions), instead of drawing it.
+//! flush(img) then draws them, in order, with the same pixels as drawing the chains directly;
+//! the list is kept, so it can be flushed onto any number of frames without measuring again.
+class CV_EXPORTS display_list
+{
+public:
+    typedef image_ostream::Command Command;
+
+    //! Draws every command, in recorded order, adding the pixels they change to any damage
+    void flush(InputOutputArray img, damage_region* damage = nullptr) const;
+    //! Draws one command, as a stream does
+    static void draw(InputOutputArray img, const Command& command);
+    //! Holds every pixel draw() may change (unclipped)
+    static Rect bounds(const Command& command);
+    //! Holds every pixel flush() may change (unclipped)
+    Rect bounds() const;
+
+    void push(Command command) { _commands.push_back(std::move(command)); }
+    void clear() { _commands.clear(); }
+    bool empty() const { return _commands.empty(); }
+    size_t size() const { return _commands.size(); }
+    const std::vector<Command>& commands() const { return _commands; }
+
+protected:
+    // The switch of draw(), once the command is culled and trimmed to the image
+    static void _render(InputOutputArray img, const Command& command);
+    // How many bytes of a line, from its start, may draw left of column right
+    static size_t _visibleBytes(const Command& command, Point org, int thickness, int right);
+
+    std::vector<Command> _commands;
+};
+
+//! Text drawn once into sparse tiles, then composited onto every frame: a static HUD (camera
+//! names, legends, watermarks) costs a blend of the tiles it covers per frame, instead of
+//! laying out and drawing it again. Each tile holds premultiplied color, then alpha, so
+//! composite() is frame = color + frame*(1 - alpha); only tiles with something drawn are kept.
+//! Pixels match drawing the commands directly wherever they're opaque (LINE_4, LINE_8, filled
+//! backgrounds); LINE_AA edges may differ by a rounding step.
+class CV_EXPORTS text_overlay
+{
+public:
+    typedef image_ostream::Command Command;
+
+    struct Tile
+    {
+        Rect rect;
+        Mat pixels; //!< CV_8UC(cn + 1): premultiplied color channels, then alpha
+    };
+
+    //! For frames of size and type (CV_8UC1, CV_8UC3 or CV_8UC4)
+    explicit text_overlay(Size size, int type = CV_8UC3, int tileSize = 64);
+
+    //! Renders the list's commands into tiles, as its flush() would draw them
+    void build(const display_list& list);
+    //! build(), only if the list's commands changed since the last one; returns whether it did
+    bool update(const display_list& list);
+    void clear();
+
+    //! Blends the tiles onto frame (of size() and type()), with OpenCV's universal intrinsics.
+    //! For CV_8UC4, the tiles' five channels are gathered into lanes in scalar code
+    void composite(InputOutputArray frame) const;
+    void compositeScalar(InputOutputArray frame) const;
+
+    //! One row of width pixels with cn (1, 3 or 4) interleaved channels, under width tile
+    //! pixels of cn + 1 channels
+    static void compositeRow(uchar* dst, const uchar* src, int width, int cn);
+    static void compositeRowScalar(uchar* dst, const uchar* src, int width, int cn);
+
+    Size size() const { return _size; }
+    int type() const { return _type; }
+    const std::vector<Tile>& tiles() const { return _tiles; }
+    bool empty() const { return _tiles.empty(); }
+
+protected:
+    template<int cn> static int _compositeRowSimd(uchar* dst, const uchar* src, int width);
+    void _composite(InputOutputArray frame, bool simd) const;
+
+    Size _size;
+    int _type;
+    int _tileSize;
+    std::vector<Tile> _tiles;
+    std::vector<Command> _built; // what the tiles hold, for update()
 };
 
 //! Creates and return image_ostream object to render text on the image like the std::cout does.
@@ -218,7 +1048,8 @@ static inline image_ostream putText(
     cv::HersheyFonts fontFace = cv::FONT_HERSHEY_SIMPLEX,
     cv::LineTypes lineType = cv::LINE_8, std::optional<bool> bottomLeftOrigin = std::nullopt /*false*/,
     std::optional<image_ostream::TextAlign> align = std::nullopt /*image_ostream::TextAlign::Left*/,
-    std::optional<bool> reverse = std::nullopt /*false*/ )
+    std::optional<bool> reverse = std::nullopt /*false*/,
+    std::optional<image_ostream::Backend> backend = std::nullopt /*image_ostream::Backend::Stroke*/ )
 {
     return image_ostream(img, origin,
 #define X(type, name, default_val) name,
@@ -234,7 +1065,8 @@ static inline image_ostream putText(
     cv::HersheyFonts fontFace = cv::FONT_HERSHEY_SIMPLEX,
     cv::LineTypes lineType = cv::LINE_8, std::optional<bool> bottomLeftOrigin = std::nullopt /*false*/,
     std::optional<image_ostream::TextAlign> align = std::nullopt /*image_ostream::TextAlign::Left*/,
-    std::optional<bool> reverse = std::nullopt /*false*/ )
+    std::optional<bool> reverse = std::nullopt /*false*/,
+    std::optional<image_ostream::Backend> backend = std::nullopt /*image_ostream::Backend::Stroke*/ )
 {
     return image_ostream(noArray(), Point(0,0),
 #define X(type, name, default_val) name,
@@ -279,44 +1111,190 @@ static inline image_ostream putText_RelativeTo(
         horz, vert, inside, textboxBottomLeftOrigin, pad_x, pad_y);
 }
 
-#ifdef CV2_PUTTEXT_HPP_IMPL
+//! The settings of an image_ostream as plain values: the style of a text_label
+struct CV_EXPORTS text_style
+{
+#define X(type, name, default_val) type name = default_val;
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
 
-cv::image_ostream::Debug cv::image_ostream::_Debug;
+    bool operator==(const text_style& rhs) const
+    {
+        return true
+#define X(type, name, default_val) && name == rhs.name
+            CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+            CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+            ;
+    }
+};
 
-image_ostream::~image_ostream()
+//! One label of putTextBatch(): cv::putText(img, origin, style...) << text
+struct CV_EXPORTS text_label
 {
-    if(!_img.empty()){
-        _nextLine();
-    }
+    Point origin;
+    std::string text;
+    text_style style;
+};
+
+//! Draws labels[0, count) in order, with the same pixels as the chain of
+//! cv::putText(img, label.origin, label.style...) << label.text, without building an
+//! image_ostream per label: labels are grouped by style, and each style's stream is set up
+//! once and reused for all of its labels.
+//! Big batches on tall enough images are drawn in horizontal bands, in parallel on
+//! cv::getNumThreads() threads; the pixels are the same.
+//! textboxes, if given, gets each label's Textbox result (an empty Rect for empty text).
+CV_EXPORTS void putTextBatch(InputOutputArray img, const text_label* labels, size_t count,
+    std::vector<Rect>* textboxes = nullptr);
+
+static inline void putTextBatch(InputOutputArray img, const std::vector<text_label>& labels,
+    std::vector<Rect>* textboxes = nullptr)
+{
+    putTextBatch(img, labels.data(), labels.size(), textboxes);
 }
 
-void image_ostream::_nextLine()
+//! One place for a label around its anchor: where putText_RelativeTo(img, anchor, vert, horz,
+//! inside, pad) would put it
+struct CV_EXPORTS label_placement
+{
+    image_ostream::VertAlign vert = image_ostream::VertAlign::Top;
+    image_ostream::TextAlign horz = image_ostream::TextAlign::Left;
+    bool inside = false;
+};
+
+//! A label for an anchor, like a detection's box; placeLabels() picks its origin
+struct CV_EXPORTS anchored_label
+{
+    Rect anchor;
+    text_label label;
+    //! In order of preference; if empty, those given to placeLabels()
+    std::vector<label_placement> placements;
+};
+
+//! Places labels[0, count) in order, each at the first of its placements that lies inside an
+//! image of imgSize and whose ink is clear of the labels placed before it (the bounds of their
+//! strokes, descenders and all, as culled). Placed labels are appended to placed, with their
+//! origin, and the style's align, bottomLeftOrigin and reverse, set as putText_RelativeTo()
+//! would; labels with no free placement are left out. chosen, if given, gets each label's
+//! placement index, or -1. A label is recorded (not drawn) once per layout its placements
+//! use, each placement tried moves that ink, and tests it against its neighbours in a grid of
+//! placed labels.
+//! placements defaults to above the anchor, left then right, below it likewise, then inside it.
+CV_EXPORTS void placeLabels(Size imgSize, const anchored_label* labels, size_t count,
+    std::vector<text_label>& placed, std::vector<int>* chosen = nullptr,
+    const std::vector<label_placement>* placements = nullptr, int pad = 6);
+
+//! placeLabels(), then putTextBatch() of the placed labels
+CV_EXPORTS void putTextPlaced(InputOutputArray img, const anchored_label* labels, size_t count,
+    std::vector<int>* chosen = nullptr, const std::vector<label_placement>* placements = nullptr, int pad = 6);
+
+static inline void putTextPlaced(InputOutputArray img, const std::vector<anchored_label>& labels,
+    std::vector<int>* chosen = nullptr, const std::vector<label_placement>* placements = nullptr, int pad = 6)
+{
+    putTextPlaced(img, labels.data(), labels.size(), chosen, placements, pad);
+}
+
+//! A retained HUD: named text slots, each with its own style and anchor, kept drawn over a saved
+//! background. render() lays out and draws again only the slots whose text (or style) changed,
+//! after restoring their old area from the background; slots overlapping that area are redrawn
+//! from their recorded commands, and every other slot is left as it is.
+class CV_EXPORTS text_hud
+{
+public:
+    //! Records a slot's text into list, as a stream with displayList(&list) would
+    typedef std::function<void(const std::string& text, display_list& list)> Recorder;
+
+    struct Stats
+    {
+        size_t renders = 0;
+        size_t changed = 0; // slots laid out and drawn again
+        size_t redrawn = 0; // unchanged slots drawn again, overlapping a changed one
+        size_t skipped = 0; // slots left as they were
+    };
+
+    explicit text_hud(InputArray background);
+
+    //! Adds a slot, drawn over those added before it, or restyles an existing one
+    void slot(const std::string& name, Point origin, const text_style& style = text_style());
+    //! As above, with any stream (like image_ostream_fancy) to record the text
+    void slot(const std::string& name, Recorder record);
+    //! Sets a slot's text; text as already drawn costs nothing in render()
+    void set(const std::string& name, const std::string& text);
+    void erase(const std::string& name);
+    //! Replaces the background; every slot is drawn again
+    void background(InputArray background);
+
+    //! Brings image() up to date, adding the pixels it changed to damage; returns this render's
+    //! counts (stats() has the totals)
+    Stats render(damage_region* damage = nullptr);
+    const Mat& image() const { return _image; }
+    Stats stats() const { return _stats; }
+
+protected:
+    struct Slot
+    {
+        std::string name;
+        Recorder record;
+        std::string text;
+        std::string drawn; // the text in list
+        display_list list;
+        Rect box;          // list's bounds, on the image
+        bool fresh = true; // new, restyled, or over a new background
+    };
+    Slot& _slot(const std::string& name);
+
+    Mat _background;
+    Mat _image;
+    std::vector<Slot> _slots;
+    std::vector<Rect> _erased; // boxes of erased slots, restored at the next render()
+    Stats _stats;
+};
+
+template<typename Visit>
+text_layout image_ostream::_layoutLines(int thickness, Visit&& visit) const
 {
 #define X(type, name, default_val) const type _##name = _##name##_opt ? _##name##_opt.value() : default_val;
     CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
 #undef X
-    if(_str.str().empty()){ return; }
-    if(_reverse){ _reverseLines(); }
-    if(_Debug.draw_origin) cv::drawMarker(_img, _origin, cv::Scalar(0, 0, 255));
-
-    const bool oneline = _str.str().find('\n') == std::string::npos;
+    (void)_backend;
+    const std::string_view text = _buf.view();
+    const bool oneline = text.find('\n') == std::string_view::npos;
     const int midline_adj_k = (_bottomLeftOrigin ? 1 : -1)
             * (oneline && _align == TextAlign::Center ? 1 : 0);
+    const size_t count = (size_t)std::count(text.begin(), text.end(), '\n') + 1;
 
-    std::string line;
+    text_layout::Line line;
+    int offset = _offset;
     int max_width = 0;
-    do
+    // Reversed, the lines are taken last first, and stacked up from the origin
+    for(size_t i = 0, start = 0, end = _reverse ? text.size() : 0; i < count; ++i)
     {
-        std::getline(_str, line);
-        replaceAll(line, "\t", "  ");
+        if(_reverse)
+        {
+            const size_t nl = end == 0 ? std::string_view::npos : text.rfind('\n', end - 1);
+            start = nl == std::string_view::npos ? 0 : nl + 1;
+        }
+        else
+        {
+            end = text.find('\n', start); // npos for the last line: the rest
+        }
+        line.text.assign(text.substr(start, end - start));
+        replaceAll(line.text, "\t", "  ");
+        if(_reverse) end = start - 1;
+        else start = end + 1;
 
         // baseline is the distance from the line letters are written on
         // to the bottom of characters that go below the line, like 'g' or 'y'
         // height without baseline will cover 'ABC' but not 'g'
         int baseLine;
-        const cv::Size textSize = _getLineSize(line, baseLine);
+        cv::Size textSize;
+        {
+            const render_stats::Timer measuring(render_stats::Counter::measureTicks);
+            textSize = text_metrics_cache::global().getTextSize(line.text, _fontFace, _fontScale, thickness, &baseLine);
+        }
 
-        const int line_width = line.empty() ? 0 : textSize.width;
+        const int line_width = line.text.empty() ? 0 : textSize.width;
         const int line_height = textSize.height + baseLine;
         // Note: we shift textSize.height to make the origin the upper-left corner
         const int offset_adj = (_bottomLeftOrigin ? 0 : textSize.height);
@@ -327,73 +1305,1701 @@ void image_ostream::_nextLine()
             _align == TextAlign::Right  ? -line_width :
             /* _align == Left */ 0;
 
-        if(_pLineSizes) _pLineSizes->emplace_back(line_width, offset_height);
+        line.at = origin(alignment_shift, offset + midline_adj);
+        line.org = line.at + cv::Point(0, offset_adj);
+        line.size = cv::Size(line_width, textSize.height);
+        line.baseLine = baseLine;
+        line.advance = offset_height;
         if(line_width > max_width) max_width = line_width;
+        visit(static_cast<const text_layout::Line&>(line));
 
-        if(line.empty()){
-            _offset += offset_height;
-            continue;
-        }
-
-        cv::putText(_img, line,
-            origin(alignment_shift, _offset + offset_adj + midline_adj),
-            _fontFace, _fontScale, _color, _thickness, _lineType, false);
+        offset += offset_height;
+    }
+    return _layoutBlock(max_width, offset, oneline);
+}
 
-        _offset += offset_height;
-    } while (!_str.eof());
+#ifdef CV2_PUTTEXT_HPP_IMPL
 
-    _str.str("");
-    _str.clear();
+} // namespace cv
+// For the SIMD kernels; only the implementation needs them
+#include <opencv2/core/hal/intrin.hpp>
+namespace cv {
 
-    if(_pTextSize)
+hershey_metrics::hershey_metrics(int fontFace)
+    : _fontFace(fontFace)
+{
+    // At scale 1 and thickness 0, cv::getTextSize() does no rounding:
+    // width is the sum of the glyph advances, height is cap + base line
+    int base = 0;
+    _height = cv::getTextSize("", fontFace, 1.0, 0, &base).height;
+    _baseLine = base;
+    std::string glyph(1, ' ');
+    for(int c = ' '; c < 127; ++c)
+    {
+        glyph[0] = (char)c;
+        _advance[c] = cv::getTextSize(glyph, fontFace, 1.0, 0, nullptr).width;
+    }
+    for(int c = 0; c < 256; ++c)
+    {
+        if(c < ' ' || c >= 127) _advance[c] = _advance[(int)'?'];
+    }
+
+    // Each glyph stroked at a scale of kScale pixels per font unit, at thickness 1, with room
+    // for 32 units around its box; how far its ink reaches past the box, rounded up to units
+    const int kScale = 4, pad = 32*kScale;
+    _reach = Reach{0, 0, 0, 0};
+    Mat ink;
+    for(int c = ' ' + 1; c < 127; ++c)
+    {
+        glyph[0] = (char)c;
+        const Size size = cv::getTextSize(glyph, fontFace, kScale, 1, &base);
+        ink.create(size.height + base + 2*pad, size.width + 2*pad, CV_8UC1);
+        ink.setTo(Scalar::all(0));
+        cv::putText(ink, glyph, Point(pad, pad + size.height), fontFace, kScale, Scalar::all(255), 1, cv::LINE_8, false);
+        const Rect box = cv::boundingRect(ink);
+        if(box.empty()) continue;
+        const auto units = [kScale](int pixels){ return std::max(0, (pixels + kScale - 1) / kScale); };
+        _reach.left = std::max(_reach.left, units(pad - box.x));
+        _reach.top = std::max(_reach.top, units(pad - box.y));
+        _reach.right = std::max(_reach.right, units(box.br().x - (pad + size.width)));
+        _reach.bottom = std::max(_reach.bottom, units(box.br().y - (pad + size.height + base)));
+    }
+}
+
+const hershey_metrics* hershey_metrics::get(int fontFace)
+{
+    const int face = fontFace & ~cv::FONT_ITALIC;
+    if(face < cv::FONT_HERSHEY_SIMPLEX || face > cv::FONT_HERSHEY_SCRIPT_COMPLEX)
+        return nullptr;
+    const int slot = face + ((fontFace & cv::FONT_ITALIC) ? 8 : 0);
+    static std::once_flag once[16];
+    static std::unique_ptr<hershey_metrics> tables[16];
+    std::call_once(once[slot], [&](){ tables[slot].reset(new hershey_metrics(fontFace)); });
+    return tables[slot].get();
+}
+
+Size hershey_metrics::getTextSize(const std::string& text, double fontScale, int thickness, int* baseLine) const
+{
+    if(!summable(text))
+    {
+        render_stats::add(render_stats::Counter::textSizeCalls);
+        return cv::getTextSize(text, _fontFace, fontScale, thickness, baseLine);
+    }
+    // Keep the order of operations of cv::getTextSize(), so the rounding matches
+    double view_x = 0;
+    for(const char c : text)
+    {
+        view_x += _advance[(uchar)c]*fontScale;
+    }
+    if(baseLine) *baseLine = cvRound(_baseLine*fontScale + thickness*0.5);
+    return Size(cvRound(view_x + thickness), cvRound(_height*fontScale + (thickness+1)/2));
+}
+
+bool hershey_metrics::summable(const std::string& text) const
+{
+    if(_fontFace == cv::FONT_HERSHEY_COMPLEX)
+    {
+        for(const char c : text)
+        {
+            if((uchar)c >= 0x80) return false;
+        }
+    }
+    return true;
+}
+
+hershey_metrics::Reach hershey_metrics::reach(const std::string& text) const
+{
+    return summable(text) ? _reach : Reach{16, 16, 16, 16};
+}
+
+std::atomic<size_t> text_metrics_cache::_capacityForAll{1024};
+
+text_metrics_cache::text_metrics_cache(size_t capacity)
+    : _capacity(capacity)
+    , _hits(0)
+    , _misses(0)
+    , _direct(0)
+    , _globalCapacity(capacity)
+{
+}
+
+text_metrics_cache& text_metrics_cache::global()
+{
+    static thread_local text_metrics_cache cache(_capacityForAll.load(std::memory_order_relaxed));
+    // Takes a new setGlobalCapacity(); otherwise a relaxed load and a branch
+    const size_t capacity = _capacityForAll.load(std::memory_order_relaxed);
+    if(cache._globalCapacity != capacity)
+    {
+        cache._globalCapacity = capacity;
+        cache.setCapacity(capacity);
+    }
+    return cache;
+}
+
+void text_metrics_cache::setGlobalCapacity(size_t capacity)
+{
+    _capacityForAll.store(capacity, std::memory_order_relaxed);
+}
+
+size_t text_metrics_cache::globalCapacity()
+{
+    return _capacityForAll.load(std::memory_order_relaxed);
+}
+
+size_t text_metrics_cache::_hash(const std::string& text, int fontFace, double fontScale, int thickness)
+{
+    size_t h = std::hash<std::string>()(text);
+    const auto combine = [&h](size_t v){ h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2); };
+    combine(std::hash<int>()(fontFace));
+    combine(std::hash<double>()(fontScale));
+    combine(std::hash<int>()(thickness));
+    return h;
+}
+
+text_metrics_cache::EntryIt text_metrics_cache::_find(
+    size_t hash, const std::string& text, int fontFace, double fontScale, int thickness)
+{
+    const auto range = _index.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        const Entry& e = *it->second;
+        if(e.fontFace == fontFace && e.fontScale == fontScale
+            && e.thickness == thickness && e.text == text)
+            return it->second;
+    }
+    return _lru.end();
+}
+
+void text_metrics_cache::_evict(size_t capacity)
+{
+    while(_lru.size() > capacity)
+    {
+        const EntryIt victim = std::prev(_lru.end());
+        const auto range = _index.equal_range(victim->hash);
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(it->second == victim){ _index.erase(it); break; }
+        }
+        _lru.erase(victim);
+    }
+}
+
+Size text_metrics_cache::_measure(const hershey_metrics* glyphs, const std::string& text, int fontFace,
+                                  double fontScale, int thickness, int* baseLine)
+{
+    if(!glyphs) render_stats::add(render_stats::Counter::textSizeCalls);
+    const Size size = glyphs ?
+        glyphs->getTextSize(text, fontScale, thickness, baseLine) :
+        cv::getTextSize(text, fontFace, fontScale, thickness, baseLine);
+    if(glyphs && image_ostream::_Debug.verify_metrics)
+    {
+        render_stats::add(render_stats::Counter::textSizeCalls);
+        int verifyBase = 0;
+        CV_Assert(size == cv::getTextSize(text, fontFace, fontScale, thickness, &verifyBase));
+        CV_Assert(!baseLine || *baseLine == verifyBase);
+    }
+    return size;
+}
+
+Size text_metrics_cache::getTextSize(
+    const std::string& text, int fontFace, double fontScale, int thickness, int* baseLine)
+{
+    const hershey_metrics* glyphs = hershey_metrics::get(fontFace);
+    if(glyphs && text.size() < directLength && glyphs->summable(text))
+    {
+        ++_direct;
+        return _measure(glyphs, text, fontFace, fontScale, thickness, baseLine);
+    }
+    const size_t hash = _hash(text, fontFace, fontScale, thickness);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const EntryIt it = _find(hash, text, fontFace, fontScale, thickness);
+        if(it != _lru.end())
+        {
+            _lru.splice(_lru.begin(), _lru, it);
+            ++_hits;
+            if(baseLine) *baseLine = it->baseLine;
+            return it->size;
+        }
+    }
+    // Measure outside the lock; a racing thread may insert the same key first
+    ++_misses;
+    int base = 0;
+    const Size size = _measure(glyphs, text, fontFace, fontScale, thickness, &base);
+    if(baseLine) *baseLine = base;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_capacity == 0 || _find(hash, text, fontFace, fontScale, thickness) != _lru.end())
+        return size;
+    _lru.push_front(Entry{hash, text, fontFace, fontScale, thickness, size, base});
+    _index.emplace(hash, _lru.begin());
+    _evict(_capacity);
+    return size;
+}
+
+text_metrics_cache::Stats text_metrics_cache::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats s;
+    s.hits = _hits;
+    s.misses = _misses;
+    s.direct = _direct;
+    s.entries = _lru.size();
+    s.capacity = _capacity;
+    return s;
+}
+
+void text_metrics_cache::resetStats()
+{
+    _hits = 0;
+    _misses = 0;
+    _direct = 0;
+}
+
+void text_metrics_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _index.clear();
+    _lru.clear();
+}
+
+void text_metrics_cache::setCapacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capacity = capacity;
+    _evict(_capacity);
+}
+
+std::atomic<bool> render_stats::_enabled{false};
+
+struct render_stats::_Registry
+{
+    std::mutex mutex;
+    std::vector<const _Slot*> live;
+    int64_t exited[_count] = {};   // summed from the slots of exited threads
+    int64_t baseline[_count] = {}; // the sum at the last reset()
+};
+
+struct render_stats::_Slot
+{
+    std::atomic<int64_t> values[_count] = {};
+    _Slot()
+    {
+        _Registry& registry = _registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.live.push_back(this);
+    }
+    ~_Slot()
+    {
+        _Registry& registry = _registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for(int i = 0; i < _count; ++i) registry.exited[i] += values[i].load(std::memory_order_relaxed);
+        registry.live.erase(std::find(registry.live.begin(), registry.live.end(), this));
+    }
+};
+
+render_stats::_Registry& render_stats::_registry()
+{
+    static _Registry registry;
+    return registry;
+}
+
+std::atomic<int64_t>* render_stats::_local()
+{
+    static thread_local _Slot slot;
+    return slot.values;
+}
+
+void render_stats::_sum(int64_t* values)
+{
+    const _Registry& registry = _registry();
+    std::copy(registry.exited, registry.exited + _count, values);
+    for(const _Slot* slot : registry.live)
+        for(int i = 0; i < _count; ++i) values[i] += slot->values[i].load(std::memory_order_relaxed);
+}
+
+render_stats::Counters render_stats::snapshot()
+{
+    _Registry& registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    int64_t values[_count];
+    _sum(values);
+    Counters counters;
+#define X(name) counters.name = values[(int)Counter::name] - registry.baseline[(int)Counter::name];
+    CV2_PUTTEXT_HPP__RENDER_STATS_X
+#undef X
+    return counters;
+}
+
+void render_stats::reset()
+{
+    _Registry& registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    _sum(registry.baseline);
+}
+
+#ifdef CV2_PUTTEXT_TRACE
+std::mutex trace_buffer::_mutex;
+std::vector<trace_buffer::Event> trace_buffer::_ring;
+size_t trace_buffer::_capacity = 65536;
+size_t trace_buffer::_next = 0;
+size_t trace_buffer::_count = 0;
+
+void trace_buffer::setCapacity(size_t events)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capacity = std::max<size_t>(events, 1);
+    _ring.clear();
+    _ring.shrink_to_fit();
+    _next = _count = 0;
+}
+
+void trace_buffer::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _next = _count = 0;
+}
+
+void trace_buffer::record(const Event& event)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_ring.size() != _capacity) _ring.resize(_capacity);
+    _ring[_next] = event;
+    _next = (_next + 1) % _capacity;
+    _count = std::min(_count + 1, _capacity);
+}
+
+std::vector<trace_buffer::Event> trace_buffer::events()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<Event> events;
+    events.reserve(_count);
+    for(size_t i = 0; i < _count; ++i)
+        events.push_back(_ring[(_next + _capacity - _count + i) % _capacity]);
+    return events;
+}
+
+std::string trace_buffer::chromeJson()
+{
+    const std::vector<Event> all = events();
+    const double usPerTick = 1e6/cv::getTickFrequency();
+    std::string json = "{\"traceEvents\": [\n";
+    char buf[512];
+    for(size_t i = 0; i < all.size(); ++i)
+    {
+        const Event& e = all[i];
+        std::string text;
+        for(const char* c = e.text; *c; ++c)
+        {
+            if(*c == '"' || *c == '\\') text += '\\';
+            if((uchar)*c < 0x20) { text += ' '; continue; }
+            text += *c;
+        }
+        std::snprintf(buf, sizeof(buf),
+            "{\"name\": \"label\", \"cat\": \"cv2_putText\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %u, "
+            "\"args\": {\"text\": \"%s\", \"chars\": %u, \"lines\": %u, \"fontFace\": %d, \"fontScale\": %g, "
+            "\"thickness\": %d, \"outline\": %d, \"shadow\": %d, \"background\": %d",
+            e.phase, e.ticks*usPerTick, e.thread, text.c_str(), e.chars, e.lines, e.fontFace, e.fontScale,
+            e.thickness, !!(e.decorations & Outline), !!(e.decorations & Shadow), !!(e.decorations & Background));
+        json += buf;
+        if(e.phase == 'E')
+        {
+            std::snprintf(buf, sizeof(buf), ", \"box\": [%d, %d, %d, %d]", e.box.x, e.box.y, e.box.width, e.box.height);
+            json += buf;
+        }
+        json += i + 1 < all.size() ? "}},\n" : "}}\n";
+    }
+    json += "]}\n";
+    return json;
+}
+
+bool trace_buffer::writeChromeJson(const std::string& path)
+{
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if(!f) return false;
+    const std::string json = chromeJson();
+    const bool ok = std::fwrite(json.data(), 1, json.size(), f) == json.size();
+    return std::fclose(f) == 0 && ok;
+}
+#endif
+
+void mask_blend::blendRowScalar(uchar* dst, const uchar* mask, int width, int cn, const uchar* color)
+{
+    for(int x = 0; x < width; ++x, dst += cn)
+    {
+        const int a = mask[x];
+        if(!a) continue;
+        for(int k = 0; k < cn; ++k)
+        {
+            // (t + (t >> 8)) >> 8 is t/255 rounded, for t <= 255*255 + 128
+            const int t = dst[k]*(255 - a) + color[k]*a + 128;
+            dst[k] = (uchar)((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+template<int cn>
+int mask_blend::_blendRowSimd(uchar* dst, const uchar* mask, int width, const uchar* color)
+{
+    int x = 0;
+#if CV_SIMD
+    // Same arithmetic as blendRowScalar() in 16-bit lanes; nothing in it exceeds 65535
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const v_uint8 zero = vx_setzero_u8();
+    const v_uint16 v255 = vx_setall_u16(255), v128 = vx_setall_u16(128);
+    v_uint16 c[cn];
+    for(int k = 0; k < cn; ++k) c[k] = vx_setall_u16(color[k]);
+    for(; x <= width - lanes; x += lanes)
+    {
+        const v_uint8 a = vx_load(mask + x);
+        if(!v_check_any(v_ne(a, zero))) continue; // text masks are mostly empty
+        v_uint16 a0, a1;
+        v_expand(a, a0, a1);
+        const v_uint16 b0 = v_sub(v255, a0), b1 = v_sub(v255, a1);
+
+        uchar* p = dst + x*cn;
+        v_uint8 d[cn];
+        if constexpr(cn == 1) d[0] = vx_load(p);
+        else if constexpr(cn == 3) v_load_deinterleave(p, d[0], d[1], d[2]);
+        else v_load_deinterleave(p, d[0], d[1], d[2], d[3]);
+        for(int k = 0; k < cn; ++k)
+        {
+            v_uint16 d0, d1;
+            v_expand(d[k], d0, d1);
+            d0 = v_add(v_add(v_mul(d0, b0), v_mul(c[k], a0)), v128);
+            d1 = v_add(v_add(v_mul(d1, b1), v_mul(c[k], a1)), v128);
+            d[k] = v_pack(v_shr<8>(v_add(d0, v_shr<8>(d0))), v_shr<8>(v_add(d1, v_shr<8>(d1))));
+        }
+        if constexpr(cn == 1) v_store(p, d[0]);
+        else if constexpr(cn == 3) v_store_interleave(p, d[0], d[1], d[2]);
+        else v_store_interleave(p, d[0], d[1], d[2], d[3]);
+    }
+    vx_cleanup();
+#else
+    CV_UNUSED(dst); CV_UNUSED(mask); CV_UNUSED(width); CV_UNUSED(color);
+#endif
+    return x;
+}
+
+void mask_blend::blendRow(uchar* dst, const uchar* mask, int width, int cn, const uchar* color)
+{
+    int x = 0;
+    switch(cn)
+    {
+    case 1: x = _blendRowSimd<1>(dst, mask, width, color); break;
+    case 3: x = _blendRowSimd<3>(dst, mask, width, color); break;
+    case 4: x = _blendRowSimd<4>(dst, mask, width, color); break;
+    default: CV_Error(cv::Error::StsBadArg, "mask_blend: 1, 3 or 4 channels");
+    }
+    blendRowScalar(dst + x*cn, mask + x, width - x, cn, color); // tail
+}
+
+void mask_blend::_blend(InputOutputArray _img, InputArray _mask, const Scalar& color, bool simd)
+{
+    Mat img = _img.getMat();
+    const Mat mask = _mask.getMat();
+    CV_Assert(mask.type() == CV_8UC1 && mask.size() == img.size());
+    const int cn = img.channels();
+    if(img.depth() != CV_8U || (cn != 1 && cn != 3 && cn != 4))
+    {
+        img.setTo(color, mask);
+        return;
+    }
+    uchar rgba[4];
+    for(int k = 0; k < cn; ++k) rgba[k] = saturate_cast<uchar>(color[k]);
+    for(int y = 0; y < img.rows; ++y)
+    {
+        if(simd) blendRow(img.ptr(y), mask.ptr(y), img.cols, cn, rgba);
+        else blendRowScalar(img.ptr(y), mask.ptr(y), img.cols, cn, rgba);
+    }
+}
+
+void mask_blend::blend(InputOutputArray img, InputArray mask, const Scalar& color)
+{
+    _blend(img, mask, color, true);
+}
+
+void mask_blend::blendScalar(InputOutputArray img, InputArray mask, const Scalar& color)
+{
+    _blend(img, mask, color, false);
+}
+
+glyph_atlas::glyph_atlas(const hershey_metrics* metrics, double fontScale, int thickness, int lineType)
+    : _metrics(metrics)
+    , _fontScale(fontScale)
+    , _thickness(thickness)
+    , _lineType(lineType)
+    , _hscale(cvRound(fontScale*(1 << 16)))
+    , _period((1 << 16)/std::gcd(_hscale, 1 << 16))
+    , _shelf(0, 0)
+    , _shelfHeight(0)
+{
+}
+
+glyph_atlas* glyph_atlas::get(int fontFace, double fontScale, int thickness, int lineType)
+{
+    if(lineType != cv::LINE_4 && lineType != cv::LINE_8) return nullptr;
+    const hershey_metrics* metrics = hershey_metrics::get(fontFace);
+    if(!metrics || !(fontScale > 0) || thickness <= 0) return nullptr;
+
+    Registry& registry = _registry();
+    std::lock_guard<std::mutex> lock(registry.mutex); // this thread's; uncontended
+    std::unique_ptr<glyph_atlas>& atlas = registry.atlases[
+        Registry::Key(fontFace, fontScale, thickness, lineType)];
+    if(!atlas) atlas.reset(new glyph_atlas(metrics, fontScale, thickness, lineType));
+    return atlas.get();
+}
+
+glyph_atlas::Registry::Registry()
+{
+    Threads& threads = _threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    threads.registries.push_back(this);
+}
+
+glyph_atlas::Registry::~Registry()
+{
+    Threads& threads = _threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    for(const auto& entry : atlases)
+    {
+        // Their glyphs go with them; their counts are kept
+        Stats s = entry.second->stats();
+        threads.bytes -= s.bytes;
+        s.glyphs = s.pages = s.bytes = 0;
+        _add(threads.exited, s);
+    }
+    threads.registries.erase(std::find(threads.registries.begin(), threads.registries.end(), this));
+}
+
+glyph_atlas::Registry& glyph_atlas::_registry()
+{
+    static thread_local Registry registry;
+    return registry;
+}
+
+glyph_atlas::Threads& glyph_atlas::_threads()
+{
+    static Threads threads;
+    return threads;
+}
+
+void glyph_atlas::_add(Stats& sum, const Stats& s)
+{
+    sum.hits += s.hits;
+    sum.misses += s.misses;
+    sum.glyphs += s.glyphs;
+    sum.pages += s.pages;
+    sum.bytes += s.bytes;
+    sum.fallbacks += s.fallbacks;
+    sum.mismatches += s.mismatches;
+    sum.evictions += s.evictions;
+}
+
+glyph_atlas::Stats glyph_atlas::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+glyph_atlas::Stats glyph_atlas::globalStats()
+{
+    Threads& threads = _threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    Stats sum = threads.exited;
+    for(Registry* registry : threads.registries)
+    {
+        std::lock_guard<std::mutex> registryLock(registry->mutex);
+        for(const auto& entry : registry->atlases) _add(sum, entry.second->stats());
+    }
+    return sum;
+}
+
+void glyph_atlas::clearAll()
+{
+    Threads& threads = _threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    for(Registry* registry : threads.registries)
+    {
+        std::lock_guard<std::mutex> registryLock(registry->mutex);
+        for(const auto& entry : registry->atlases)
+        {
+            std::lock_guard<std::mutex> atlasLock(entry.second->_mutex);
+            entry.second->_clear();
+        }
+    }
+}
+
+void glyph_atlas::setGlobalByteBudget(size_t bytes)
+{
+    _threads().budget = bytes;
+}
+
+size_t glyph_atlas::globalByteBudget()
+{
+    return _threads().budget;
+}
+
+void glyph_atlas::_evict()
+{
+    Threads& threads = _threads();
+    std::lock_guard<std::mutex> lock(threads.mutex);
+    while(threads.budget && threads.bytes > threads.budget)
+    {
+        glyph_atlas* lru = nullptr;
+        for(Registry* registry : threads.registries)
+        {
+            std::lock_guard<std::mutex> registryLock(registry->mutex);
+            for(const auto& entry : registry->atlases)
+            {
+                glyph_atlas* atlas = entry.second.get();
+                if(atlas->stats().bytes > 0 && (!lru || atlas->_used < lru->_used)) lru = atlas;
+            }
+        }
+        if(!lru) break;
+        // Its registry is listed, so its thread hasn't exited; masks handed out keep their pages
+        std::lock_guard<std::mutex> atlasLock(lru->_mutex);
+        lru->_clear();
+        ++lru->_stats.evictions;
+    }
+}
+
+Mat glyph_atlas::_allocate(Size size)
+{
+    // Shelf packing; a glyph bigger than a page gets a page of its own
+    const int kPageSize = 256;
+    Threads& threads = _threads();
+    ++threads.clock;
+    if(size.width > kPageSize || size.height > kPageSize)
+    {
+        _pages.emplace_back(size, CV_8UC1);
+        _shelf = Point(kPageSize, kPageSize); // retire the shelf; next glyph opens a new page
+        _stats.bytes += size.area();
+        threads.bytes += size.area();
+        return _pages.back();
+    }
+    if(_pages.empty() || _shelf.x + size.width > kPageSize)
+    {
+        _shelf = Point(0, _shelf.y + _shelfHeight);
+        _shelfHeight = 0;
+    }
+    if(_pages.empty() || _shelf.y + size.height > kPageSize)
+    {
+        _pages.emplace_back(kPageSize, kPageSize, CV_8UC1);
+        _shelf = Point(0, 0);
+        _shelfHeight = 0;
+        _stats.bytes += kPageSize*kPageSize;
+        threads.bytes += kPageSize*kPageSize;
+    }
+    const Mat mask = _pages.back()(Rect(_shelf, size));
+    _shelf.x += size.width;
+    _shelfHeight = std::max(_shelfHeight, size.height);
+    return mask;
+}
+
+void glyph_atlas::_clear()
+{
+    // Masks handed out keep their page alive until they're blitted
+    _glyphs.clear();
+    _pages.clear();
+    _shelf = Point(0, 0);
+    _shelfHeight = 0;
+    _threads().bytes -= _stats.bytes;
+    _stats.glyphs = 0;
+    _stats.pages = 0;
+    _stats.bytes = 0;
+}
+
+const glyph_atlas::Glyph& glyph_atlas::_glyph(uchar c, int64_t advance)
+{
+    const int phase = (int)((advance*_hscale) & 0xFFFF);
+    const uint32_t key = ((uint32_t)c << 16) | (uint32_t)phase;
+    const auto found = _glyphs.find(key);
+    if(found != _glyphs.end())
+    {
+        ++_stats.hits;
+        return found->second;
+    }
+    ++_stats.misses;
+
+    // Stroke the glyph alone at its phase. cv::putText() starts the pen on a whole pixel, so the
+    // glyph comes after glyphs whose advance sum puts it at the same phase: at most two carriers,
+    // then enough blank ' ' glyphs that the carriers' ink lands left of the canvas. Only the
+    // carriers and the glyph have strokes. Sums _period apart have the same phase.
+    const int pad = _thickness + 4 + cvCeil(_fontScale*4);
+    const int ascent = cvCeil(_fontScale*_metrics->height()) + pad;
+    const int64_t space = std::max(_metrics->advance(' '), 1);
+    int64_t gap = 1; // in blanks
+    while(gap*space*_fontScale < 4*pad) ++gap;
+    // One or two glyphs of advance sum n, or none
+    const auto carry = [this](int64_t n)
+    {
+        for(int a = ' ' + 1; a < 127; ++a)
+        {
+            const int64_t rest = n - _metrics->advance((uchar)a);
+            if(rest == 0) return std::string(1, (char)a);
+            for(int b = ' ' + 1; rest > 0 && b < 127; ++b)
+            {
+                if(_metrics->advance((uchar)b) == rest) return std::string{(char)a, (char)b};
+            }
+        }
+        return std::string();
+    };
+    // From the least sum of at least the gap at the glyph's phase, fewer blanks and more carried
+    int64_t sum = advance % _period + (gap*space + _period - 1 - advance % _period)/_period*_period;
+    int64_t blanks = -1;
+    std::string stroked;
+    for(int64_t round = 0; round < space; ++round, sum += _period)
+    {
+        for(int64_t b = sum/space; blanks < 0 && b >= gap; --b)
+        {
+            const int64_t carried = sum - b*space;
+            stroked = carried ? carry(carried) : std::string();
+            if(!carried || !stroked.empty()) blanks = b;
+        }
+        if(blanks >= 0) break;
+    }
+    Glyph glyph;
+    if(blanks < 0)
+    {
+        glyph.valid = false; // no carriers for this phase; lines using it fall back
+        ++_stats.glyphs;
+        return _glyphs.emplace(key, glyph).first->second;
+    }
+    stroked.append((size_t)blanks, ' ');
+    stroked.push_back((char)c);
+    const int64_t shift = (sum*_hscale) >> 16; // whole pixels from org to the glyph's pen
+    Mat canvas = Mat::zeros(2*ascent, cvCeil(_metrics->advance(c)*_fontScale) + 2*pad + 1, CV_8UC1);
+    cv::putText(canvas, stroked, Point((int)(pad - shift), ascent), _metrics->fontFace(), _fontScale,
+        Scalar::all(255), _thickness, _lineType, false);
+
+    glyph.valid = true;
+    const Rect ink = cv::boundingRect(canvas); // empty, at (0, 0), for blanks like ' '
+    if(ink.area() > 0 &&
+        (ink.x == 0 || ink.y == 0 || ink.br().x == canvas.cols || ink.br().y == canvas.rows))
+    {
+        glyph.valid = false; // ran off the canvas; can't tell it apart from its neighbours
+    }
+    else if(ink.area() > 0)
+    {
+        glyph.mask = _allocate(ink.size());
+        canvas(ink).copyTo(glyph.mask);
+        glyph.offset = Point(ink.x - pad, ink.y - ascent);
+    }
+    ++_stats.glyphs;
+    _stats.pages = _pages.size();
+    return _glyphs.emplace(key, glyph).first->second;
+}
+
+bool glyph_atlas::_layout(const std::string& text, Point org, Size imgSize, std::vector<Placement>& placed)
+{
+    // Only reads what other threads share, unless over the budget
+    Threads& threads = _threads();
+    _used = threads.clock.load(std::memory_order_relaxed);
+    if(threads.budget && threads.bytes > threads.budget) _evict();
+    std::lock_guard<std::mutex> lock(_mutex);
+    const size_t kMaxBytes = 8 << 20;
+    if(_stats.bytes > kMaxBytes) _clear();
+
+    // Inset by a pixel: cv::putText() clips stroke end points that fall outside the image
+    const Rect inside(1, 1, imgSize.width - 2, imgSize.height - 2);
+    const bool utf8 = _metrics->fontFace() == cv::FONT_HERSHEY_COMPLEX;
+    int64_t advance = 0; // sum of the unscaled advances before each glyph
+    for(size_t i = 0; i < text.size(); ++i)
+    {
+        uchar c = (uchar)text[i];
+        if(utf8 && c >= 0x80) { ++_stats.fallbacks; return false; }
+        if(c < ' ' || c >= 127) c = '?';
+
+        const int64_t pen = advance*_hscale;
+        const Glyph& glyph = _glyph(c, advance);
+        if(!glyph.valid) { ++_stats.fallbacks; return false; }
+        if(!glyph.mask.empty())
+        {
+            const Point tl = org + Point((int)(pen >> 16), 0) + glyph.offset;
+            if((Rect(tl, glyph.mask.size()) & inside).area() != glyph.mask.size().area())
+            {
+                ++_stats.fallbacks;
+                return false;
+            }
+            placed.push_back(Placement{glyph.mask, tl});
+        }
+        advance += _metrics->advance(c);
+    }
+    return true;
+}
+
+bool glyph_atlas::drawText(InputOutputArray _img, const std::string& text, Point org, const Scalar& color)
+{
+    std::vector<Placement> placed;
+    if(!_layout(text, org, _img.size(), placed)) return false;
+    Mat img = _img.getMat();
+    for(const Placement& p : placed)
+    {
+        Mat roi = img(Rect(p.tl, p.mask.size()));
+        mask_blend::blend(roi, p.mask, color);
+    }
+    return true;
+}
+
+bool glyph_atlas::verifyText(InputOutputArray img, const std::string& text, Point org, const Scalar& color)
+{
+    return verifyLayers(img, {Layer{this, text, org, color}});
+}
+
+bool glyph_atlas::drawLayers(InputOutputArray _img, const std::vector<Layer>& layers)
+{
+    CV_Assert(layers.size() < 256);
+    std::vector<std::vector<Placement>> placed(layers.size());
+    Rect bounds;
+    for(size_t k = 0; k < layers.size(); ++k)
+    {
+        const Layer& layer = layers[k];
+        if(!layer.atlas->_layout(layer.text, layer.org, _img.size(), placed[k])) return false;
+        for(const Placement& p : placed[k]) bounds |= Rect(p.tl, p.mask.size());
+    }
+    if(bounds.empty()) return true;
+
+    // Label each pixel with the topmost layer (1-based) whose masks cover it
+    Mat labels = Mat::zeros(bounds.size(), CV_8UC1);
+    for(size_t k = 0; k < layers.size(); ++k)
+    {
+        const uchar id = (uchar)(k + 1);
+        for(const Placement& p : placed[k])
+        {
+            for(int y = 0; y < p.mask.rows; ++y)
+            {
+                const uchar* mask = p.mask.ptr(y);
+                uchar* label = labels.ptr(p.tl.y - bounds.y + y) + (p.tl.x - bounds.x);
+                for(int x = 0; x < p.mask.cols; ++x)
+                    if(mask[x]) label[x] = id;
+            }
+        }
+    }
+
+    Mat img = _img.getMat();
+    const size_t esz = img.elemSize();
+    std::vector<Mat> colors; // each layer's color as one pixel of img's type
+    for(const Layer& layer : layers) colors.emplace_back(1, 1, img.type(), layer.color);
+    for(int y = 0; y < bounds.height; ++y)
+    {
+        const uchar* label = labels.ptr(y);
+        uchar* dst = img.ptr(bounds.y + y) + bounds.x*esz;
+        for(int x = 0; x < bounds.width; ++x, dst += esz)
+        {
+            if(!label[x]) continue;
+            const uchar* src = colors[label[x] - 1].ptr();
+            for(size_t b = 0; b < esz; ++b) dst[b] = src[b];
+        }
+    }
+    return true;
+}
+
+bool glyph_atlas::verifyLayers(InputOutputArray _img, const std::vector<Layer>& layers)
+{
+    Mat atlasImg = _img.getMat().clone();
+    if(layers.empty() || !drawLayers(atlasImg, layers)) return false;
+    for(const Layer& layer : layers)
+    {
+        const glyph_atlas& atlas = *layer.atlas;
+        cv::putText(_img, layer.text, layer.org, atlas._metrics->fontFace(), atlas._fontScale,
+            layer.color, atlas._thickness, atlas._lineType, false);
+    }
+    if(cv::norm(_img, atlasImg, cv::NORM_INF) != 0)
+    {
+        std::lock_guard<std::mutex> lock(layers.back().atlas->_mutex);
+        ++layers.back().atlas->_stats.mismatches;
+    }
+    return true;
+}
+
+void text_buffer::append(std::string_view text)
+{
+    if(text.empty()) return;
+    _reserve(text.size());
+    std::memcpy(pptr(), text.data(), text.size());
+    pbump((int)text.size());
+}
+
+void text_buffer::_reserve(size_t extra)
+{
+    const size_t used = size();
+    const size_t capacity = (size_t)(epptr() - pbase());
+    if(capacity - used >= extra) return;
+    const size_t grown = std::max(2*capacity, used + extra);
+    std::unique_ptr<char[]> heap(new char[grown]);
+    std::memcpy(heap.get(), pbase(), used);
+    _heap = std::move(heap);
+    setp(_heap.get(), _heap.get() + grown);
+    pbump((int)used);
+}
+
+text_buffer::text_buffer(text_buffer&& rhs) noexcept
+{
+    if(rhs._heap)
+    {
+        const size_t used = rhs.size();
+        _heap = std::move(rhs._heap);
+        setp(_heap.get(), rhs.epptr());
+        pbump((int)used);
+    }
+    else
+    {
+        setp(_inline, _inline + kInlineSize);
+        std::memcpy(_inline, rhs._inline, rhs.size());
+        pbump((int)rhs.size());
+    }
+    rhs.setp(rhs._inline, rhs._inline + kInlineSize);
+}
+
+text_buffer::int_type text_buffer::overflow(int_type c)
+{
+    if(traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+    append(traits_type::to_char_type(c));
+    return c;
+}
+
+std::streamsize text_buffer::xsputn(const char* s, std::streamsize n)
+{
+    append(std::string_view(s, (size_t)n));
+    return n;
+}
+
+void image_ostream::_putText(const std::string& line, cv::Point org, const cv::Scalar& color, int thickness, Backend backend)
+{
+    Command command;
+    command.kind = Command::Kind::Text;
+    command.text = line;
+    command.org = org;
+    command.color = color;
+    command.thickness = thickness;
+    command.fontFace = _fontFace;
+    command.fontScale = _fontScale;
+    command.lineType = _lineType;
+    command.backend = backend;
+    _draw(std::move(command));
+}
+
+void image_ostream::_draw(Command&& command)
+{
+    if(_displayList)
+    {
+        _displayList->push(std::move(command));
+        return;
+    }
+    if(!_damage)
+    {
+        display_list::draw(_img, command);
+        return;
+    }
+    const Mat img = _img.getMat();
+    _damage->track(img, display_list::bounds(command), [&img, &command](){ display_list::draw(img, command); });
+}
+
+Rect display_list::bounds() const
+{
+    Rect all;
+    for(const Command& command : _commands)
+    {
+        const Rect box = bounds(command);
+        if(!box.empty()) all = all.empty() ? box : (all | box);
+    }
+    return all;
+}
+
+void display_list::flush(InputOutputArray img, damage_region* damage) const
+{
+    if(!damage)
+    {
+        for(const Command& command : _commands) draw(img, command);
+        return;
+    }
+    const Mat mat = img.getMat();
+    for(const Command& command : _commands)
+        damage->track(mat, bounds(command), [&mat, &command](){ draw(mat, command); });
+}
+
+Rect display_list::bounds(const Command& c)
+{
+    // A line's cv::getTextSize() box; glyphs and strokes reach past it by the font's
+    // hershey_metrics::reach() (16 font units if it has none), the stroke's thickness, and a
+    // pixel of rounding. Summed from the font's advances, so culling every draw() costs no
+    // cache lookup
+    const hershey_metrics* metrics = hershey_metrics::get(c.fontFace);
+    const auto text = [&c, metrics](Point org, int thickness)
+    {
+        int baseLine = 0;
+        if(!metrics) render_stats::add(render_stats::Counter::textSizeCalls);
+        const Size size = metrics ?
+            metrics->getTextSize(c.text, c.fontScale, thickness, &baseLine) :
+            cv::getTextSize(c.text, c.fontFace, c.fontScale, thickness, &baseLine);
+        const hershey_metrics::Reach reach = metrics ? metrics->reach(c.text) : hershey_metrics::Reach{16, 16, 16, 16};
+        const int m = thickness + 1 + (c.lineType == cv::LINE_AA ? 1 : 0);
+        const int left = m + cvCeil(c.fontScale*reach.left), top = m + cvCeil(c.fontScale*reach.top);
+        const int right = m + cvCeil(c.fontScale*reach.right), bottom = m + cvCeil(c.fontScale*reach.bottom);
+        return Rect(org.x - left, org.y - size.height - top, size.width + left + right, size.height + baseLine + top + bottom);
+    };
+    using Kind = Command::Kind;
+    switch(c.kind)
+    {
+    case Kind::Text:
+        return c.text.empty() ? Rect() : text(c.org, c.thickness);
+    case Kind::OutlinedText:
+        return c.text.empty() ? Rect() : text(c.org, c.thickness) | text(c.org2, c.thickness2);
+    case Kind::Rectangle:
+    {
+        // Edges are stroked centered on the corners' rows and columns
+        const int m = (c.thickness > 0 ? (c.thickness + 1)/2 : 0) + (c.lineType == cv::LINE_AA ? 1 : 0);
+        const Point tl(std::min(c.org.x, c.org2.x), std::min(c.org.y, c.org2.y));
+        const Point br(std::max(c.org.x, c.org2.x), std::max(c.org.y, c.org2.y));
+        return Rect(tl - Point(m, m), br + Point(m + 1, m + 1));
+    }
+    case Kind::Marker:
+        // cv::drawMarker() defaults: a 20 pixel cross, 1 thick
+        return Rect(c.org.x - 11, c.org.y - 11, 23, 23);
+    }
+    return Rect();
+}
+
+void damage_region::add(const Rect& rect)
+{
+    if(rect.empty()) return;
+    // Absorb every rectangle it overlaps or touches; the union may reach more, so start over
+    Rect merged = rect;
+    for(size_t i = 0; i < _rects.size(); )
+    {
+        if(!_touch(_rects[i], merged))
+        {
+            ++i;
+            continue;
+        }
+        merged |= _rects[i];
+        _rects[i] = _rects.back();
+        _rects.pop_back();
+        i = 0;
+    }
+    _rects.push_back(merged);
+    if(_rects.size() <= _maxRects) return;
+
+    // Over budget: merge the pair whose union adds the least uncovered area
+    size_t best_i = 0, best_j = 1;
+    double best = std::numeric_limits<double>::max();
+    for(size_t i = 0; i < _rects.size(); ++i)
+    {
+        for(size_t j = i + 1; j < _rects.size(); ++j)
+        {
+            const double cost = (_rects[i] | _rects[j]).area() - (double)_rects[i].area() - (double)_rects[j].area();
+            if(cost < best)
+            {
+                best = cost;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+    const Rect pair = _rects[best_i] | _rects[best_j];
+    _rects.erase(_rects.begin() + best_j); // j > i, so i stays put
+    _rects.erase(_rects.begin() + best_i);
+    add(pair);
+}
+
+void damage_region::addChanged(const Mat& before, const Mat& after, Point offset)
+{
+    CV_Assert(before.size() == after.size() && before.type() == after.type());
+    // Rows by memcmp(); within the changed ones, only bytes outside the columns found so far
+    const size_t pixelBytes = after.elemSize(), rowBytes = after.cols*pixelBytes;
+    int top = -1, bottom = -1;
+    size_t left = rowBytes, right = 0; // changed bytes [left, right)
+    for(int y = 0; y < after.rows; ++y)
+    {
+        const uchar* a = before.ptr(y);
+        const uchar* b = after.ptr(y);
+        if(std::memcmp(a, b, rowBytes) == 0) continue;
+        if(top < 0) top = y;
+        bottom = y;
+        size_t l = 0, r = rowBytes;
+        while(l < left && a[l] == b[l]) ++l;
+        while(r > right && a[r - 1] == b[r - 1]) --r;
+        left = std::min(left, l);
+        right = std::max(right, r);
+    }
+    if(top < 0) return;
+    const int x0 = (int)(left/pixelBytes), x1 = (int)((right + pixelBytes - 1)/pixelBytes);
+    add(Rect(offset.x + x0, offset.y + top, x1 - x0, bottom - top + 1));
+}
+
+bool damage_region::_touch(const Rect& a, const Rect& b)
+{
+    return a.x <= b.x + b.width && b.x <= a.x + a.width
+        && a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+Rect damage_region::bounds() const
+{
+    Rect all;
+    for(const Rect& r : _rects) all = all.empty() ? r : (all | r);
+    return all;
+}
+
+size_t damage_region::area() const
+{
+    size_t pixels = 0;
+    for(const Rect& r : _rects) pixels += (size_t)r.area();
+    return pixels;
+}
+
+text_overlay::text_overlay(Size size, int type, int tileSize)
+    : _size(size)
+    , _type(type)
+    , _tileSize(tileSize)
+{
+    CV_Assert(type == CV_8UC1 || type == CV_8UC3 || type == CV_8UC4);
+    CV_Assert(tileSize > 0);
+}
+
+void text_overlay::build(const display_list& list)
+{
+    _tiles.clear();
+    _built = list.commands();
+    const Rect image(Point(0, 0), _size);
+    const int cols = (_size.width + _tileSize - 1)/_tileSize;
+    const int rows = (_size.height + _tileSize - 1)/_tileSize;
+    std::vector<uchar> touched((size_t)cols*rows, 0);
+    for(const Command& command : _built)
+    {
+        const Rect box = display_list::bounds(command) & image;
+        if(box.empty()) continue;
+        for(int ty = box.y/_tileSize; ty <= (box.y + box.height - 1)/_tileSize; ++ty)
+            for(int tx = box.x/_tileSize; tx <= (box.x + box.width - 1)/_tileSize; ++tx)
+                touched[(size_t)ty*cols + tx] = 1;
+    }
+
+    // Drawn over black, the commands leave their premultiplied color; over white, that plus
+    // what shows through. Only the touched tiles are cleared, and read back
+    const int cn = CV_MAT_CN(_type);
+    Mat black(_size, _type), white(_size, _type);
+    const auto tileRect = [&](int tx, int ty){ return Rect(tx*_tileSize, ty*_tileSize, _tileSize, _tileSize) & image; };
+    for(int ty = 0; ty < rows; ++ty)
+    {
+        for(int tx = 0; tx < cols; ++tx)
+        {
+            if(!touched[(size_t)ty*cols + tx]) continue;
+            black(tileRect(tx, ty)).setTo(Scalar::all(0));
+            white(tileRect(tx, ty)).setTo(Scalar::all(255));
+        }
+    }
+    list.flush(black);
+    list.flush(white);
+
+    for(int ty = 0; ty < rows; ++ty)
+    {
+        for(int tx = 0; tx < cols; ++tx)
+        {
+            if(!touched[(size_t)ty*cols + tx]) continue;
+            const Rect rect = tileRect(tx, ty);
+            Mat pixels(rect.size(), CV_8UC(cn + 1));
+            bool drawn = false;
+            for(int y = 0; y < rect.height; ++y)
+            {
+                const uchar* b = black.ptr(rect.y + y) + rect.x*cn;
+                const uchar* w = white.ptr(rect.y + y) + rect.x*cn;
+                uchar* p = pixels.ptr(y);
+                for(int x = 0; x < rect.width; ++x, b += cn, w += cn, p += cn + 1)
+                {
+                    // The most opaque channel's alpha; color can't exceed it
+                    int alpha = 0;
+                    for(int k = 0; k < cn; ++k) alpha = std::max(alpha, 255 - (w[k] - b[k]));
+                    for(int k = 0; k < cn; ++k) p[k] = (uchar)std::min<int>(b[k], alpha);
+                    p[cn] = (uchar)alpha;
+                    drawn |= alpha != 0;
+                }
+            }
+            if(drawn) _tiles.push_back(Tile{rect, pixels});
+        }
+    }
+}
+
+bool text_overlay::update(const display_list& list)
+{
+    if(list.commands() == _built) return false;
+    build(list);
+    return true;
+}
+
+void text_overlay::clear()
+{
+    _tiles.clear();
+    _built.clear();
+}
+
+void text_overlay::compositeRowScalar(uchar* dst, const uchar* src, int width, int cn)
+{
+    for(int x = 0; x < width; ++x, dst += cn, src += cn + 1)
     {
-        _pTextSize->width = max_width;
-        _pTextSize->height = _offset; // Negative allowed?
+        const int a = src[cn];
+        if(!a) continue;
+        for(int k = 0; k < cn; ++k)
+        {
+            // As mask_blend: (t + (t >> 8)) >> 8 is t/255 rounded
+            const int t = dst[k]*(255 - a) + 128;
+            dst[k] = (uchar)std::min(255, src[k] + ((t + (t >> 8)) >> 8));
+        }
     }
-    if(_pTextbox)
+}
+
+template<int cn>
+int text_overlay::_compositeRowSimd(uchar* dst, const uchar* src, int width)
+{
+    int x = 0;
+#if CV_SIMD
+    // Same arithmetic as compositeRowScalar() in 16-bit lanes; v_pack saturates the sum
+    const int lanes = VTraits<v_uint8>::vlanes();
+    const v_uint8 zero = vx_setzero_u8();
+    const v_uint16 v255 = vx_setall_u16(255), v128 = vx_setall_u16(128);
+    for(; x <= width - lanes; x += lanes)
     {
-        // The constructor of 2 points does the math for us
-        int x1 = _origin.x;
-        int x2 = _origin.x;
-        if(_align == TextAlign::Center)
+        v_uint8 s[cn + 1];
+        const uchar* q = src + x*(cn + 1);
+        if constexpr(cn == 1) v_load_deinterleave(q, s[0], s[1]);
+        else if constexpr(cn == 3) v_load_deinterleave(q, s[0], s[1], s[2], s[3]);
+        else
         {
-            x1 -= max_width / 2;
-            x2 += max_width / 2;
+            // Five channels: there's no five-way v_load_deinterleave, so the tile's pixels are
+            // gathered into lanes one at a time, in scalar code; the blend, and the frame's
+            // loads and stores, are still vector
+            uchar c[4][VTraits<v_uint8>::max_nlanes], a[VTraits<v_uint8>::max_nlanes];
+            for(int i = 0; i < lanes; ++i)
+            {
+                for(int k = 0; k < 4; ++k) c[k][i] = q[i*5 + k];
+                a[i] = q[i*5 + 4];
+            }
+            for(int k = 0; k < 4; ++k) s[k] = vx_load(c[k]);
+            s[4] = vx_load(a);
         }
-        else if(_align == TextAlign::Right)
+        if(!v_check_any(v_ne(s[cn], zero))) continue; // overlays are mostly clear
+        v_uint16 a0, a1;
+        v_expand(s[cn], a0, a1);
+        const v_uint16 b0 = v_sub(v255, a0), b1 = v_sub(v255, a1);
+
+        uchar* p = dst + x*cn;
+        v_uint8 d[cn];
+        if constexpr(cn == 1) d[0] = vx_load(p);
+        else if constexpr(cn == 3) v_load_deinterleave(p, d[0], d[1], d[2]);
+        else v_load_deinterleave(p, d[0], d[1], d[2], d[3]);
+        for(int k = 0; k < cn; ++k)
         {
-            x1 -= max_width;
+            v_uint16 d0, d1, c0, c1;
+            v_expand(d[k], d0, d1);
+            v_expand(s[k], c0, c1);
+            d0 = v_add(v_mul(d0, b0), v128);
+            d1 = v_add(v_mul(d1, b1), v128);
+            d[k] = v_pack(v_add(c0, v_shr<8>(v_add(d0, v_shr<8>(d0)))), v_add(c1, v_shr<8>(v_add(d1, v_shr<8>(d1)))));
+        }
+        if constexpr(cn == 1) v_store(p, d[0]);
+        else if constexpr(cn == 3) v_store_interleave(p, d[0], d[1], d[2]);
+        else v_store_interleave(p, d[0], d[1], d[2], d[3]);
+    }
+    vx_cleanup();
+#else
+    CV_UNUSED(dst); CV_UNUSED(src); CV_UNUSED(width);
+#endif
+    return x;
+}
+
+void text_overlay::compositeRow(uchar* dst, const uchar* src, int width, int cn)
+{
+    int x = 0;
+    switch(cn)
+    {
+    case 1: x = _compositeRowSimd<1>(dst, src, width); break;
+    case 3: x = _compositeRowSimd<3>(dst, src, width); break;
+    case 4: x = _compositeRowSimd<4>(dst, src, width); break;
+    default: CV_Error(cv::Error::StsBadArg, "text_overlay: 1, 3 or 4 channels");
+    }
+    compositeRowScalar(dst + x*cn, src + x*(cn + 1), width - x, cn); // tail
+}
+
+void text_overlay::_composite(InputOutputArray _frame, bool simd) const
+{
+    Mat frame = _frame.getMat();
+    CV_Assert(frame.size() == _size && frame.type() == _type);
+    const int cn = frame.channels();
+    for(const Tile& tile : _tiles)
+    {
+        for(int y = 0; y < tile.rect.height; ++y)
+        {
+            uchar* dst = frame.ptr(tile.rect.y + y) + tile.rect.x*cn;
+            if(simd) compositeRow(dst, tile.pixels.ptr(y), tile.rect.width, cn);
+            else compositeRowScalar(dst, tile.pixels.ptr(y), tile.rect.width, cn);
+        }
+    }
+}
+
+void text_overlay::composite(InputOutputArray frame) const
+{
+    _composite(frame, true);
+}
+
+void text_overlay::compositeScalar(InputOutputArray frame) const
+{
+    _composite(frame, false);
+}
+
+text_hud::text_hud(InputArray background)
+{
+    this->background(background);
+}
+
+void text_hud::slot(const std::string& name, Point origin, const text_style& style)
+{
+    slot(name, [origin, style](const std::string& text, display_list& list)
+    {
+        image_ostream(noArray(), origin
+#define X(type, name, default_val) , style.name
+            CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+            CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+            ).displayList(&list) << text;
+    });
+}
+
+void text_hud::slot(const std::string& name, Recorder record)
+{
+    for(Slot& s : _slots)
+    {
+        if(s.name != name) continue;
+        s.record = std::move(record);
+        s.fresh = true;
+        return;
+    }
+    Slot s;
+    s.name = name;
+    s.record = std::move(record);
+    _slots.push_back(std::move(s));
+}
+
+text_hud::Slot& text_hud::_slot(const std::string& name)
+{
+    for(Slot& s : _slots)
+        if(s.name == name) return s;
+    CV_Error(cv::Error::StsBadArg, "text_hud: no slot named " + name);
+}
+
+void text_hud::set(const std::string& name, const std::string& text)
+{
+    _slot(name).text = text;
+}
+
+void text_hud::erase(const std::string& name)
+{
+    Slot& s = _slot(name);
+    _erased.push_back(s.box);
+    _slots.erase(_slots.begin() + (&s - _slots.data()));
+}
+
+void text_hud::background(InputArray background)
+{
+    _background = background.getMat().clone();
+    _image = _background.clone();
+    _erased.clear();
+    for(Slot& s : _slots)
+    {
+        s.box = Rect();
+        s.fresh = true;
+    }
+}
+
+text_hud::Stats text_hud::render(damage_region* damage)
+{
+    Stats counts;
+    counts.renders = 1;
+    const Rect image(Point(0, 0), _image.size());
+    std::vector<Rect> area; // restored from the background, then drawn over
+    area.swap(_erased);
+    std::vector<bool> redraw(_slots.size(), false);
+    for(size_t i = 0; i < _slots.size(); ++i)
+    {
+        Slot& s = _slots[i];
+        if(!s.fresh && s.text == s.drawn) continue;
+        area.push_back(s.box);
+        s.list.clear();
+        if(!s.text.empty()) s.record(s.text, s.list);
+        s.box = s.list.bounds() & image;
+        s.drawn = s.text;
+        s.fresh = false;
+        area.push_back(s.box);
+        redraw[i] = true;
+        ++counts.changed;
+    }
+
+    // Whatever overlaps the area is drawn again, whole, so the area grows by its box
+    for(bool grown = true; grown; )
+    {
+        grown = false;
+        for(size_t i = 0; i < _slots.size(); ++i)
+        {
+            const Rect& box = _slots[i].box;
+            if(redraw[i] || box.empty()) continue;
+            if(std::none_of(area.begin(), area.end(), [&box](const Rect& r){ return !(r & box).empty(); }))
+                continue;
+            area.push_back(box);
+            redraw[i] = grown = true;
+            ++counts.redrawn;
+        }
+    }
+
+    // With damage, each area is compared after against a copy from before
+    std::vector<Mat> before(damage ? area.size() : 0);
+    for(size_t i = 0; i < area.size(); ++i)
+    {
+        const Rect& r = area[i];
+        if(r.empty()) continue;
+        if(damage) _image(r).copyTo(before[i]);
+        _background(r).copyTo(_image(r));
+    }
+    for(size_t i = 0; i < _slots.size(); ++i)
+        if(redraw[i]) _slots[i].list.flush(_image);
+    for(size_t i = 0; i < before.size(); ++i)
+        if(!area[i].empty()) damage->addChanged(before[i], _image(area[i]), area[i].tl());
+
+    counts.skipped = _slots.size() - counts.changed - counts.redrawn;
+    _stats.renders += counts.renders;
+    _stats.changed += counts.changed;
+    _stats.redrawn += counts.redrawn;
+    _stats.skipped += counts.skipped;
+    return counts;
+}
+
+void display_list::draw(InputOutputArray img, const Command& c)
+{
+    // Lines wholly off the image (like a scrolled-out log, or labels past its edge) draw
+    // nothing; those crossing its right edge draw only the characters that can reach it
+    const Size size = img.size();
+    const Rect box = bounds(c);
+    const Rect visible = box & Rect(Point(0, 0), size);
+    if(visible.empty()) return;
+    render_stats::add(render_stats::Counter::boundsArea, visible.area());
+    const bool text = c.kind == Command::Kind::Text || c.kind == Command::Kind::OutlinedText;
+    if(text && box.x + box.width > size.width)
+    {
+        size_t n = _visibleBytes(c, c.org, c.thickness, size.width);
+        if(c.kind == Command::Kind::OutlinedText)
+            n = std::max(n, _visibleBytes(c, c.org2, c.thickness2, size.width));
+        if(n == 0) return;
+        if(n < c.text.size())
+        {
+            Command trimmed = c;
+            trimmed.text.resize(n);
+            _render(img, trimmed);
+            return;
+        }
+    }
+    _render(img, c);
+}
+
+size_t display_list::_visibleBytes(const Command& c, Point org, int thickness, int right)
+{
+    // Each glyph is drawn from its pen position, as cv::putText() advances it in 16.16
+    // fixed-point; its strokes reach left of that by no more than bounds() allows for
+    const hershey_metrics* metrics = hershey_metrics::get(c.fontFace);
+    if(!metrics) return c.text.size();
+    const bool utf8 = c.fontFace == cv::FONT_HERSHEY_COMPLEX;
+    const int64_t hscale = cvRound(c.fontScale*(1 << 16));
+    const int m = thickness + 1 + (c.lineType == cv::LINE_AA ? 1 : 0) + cvCeil(c.fontScale*metrics->reach(c.text).left);
+    int64_t advance = 0;
+    for(size_t i = 0; i < c.text.size(); ++i)
+    {
+        const uchar ch = (uchar)c.text[i];
+        if(utf8 && ch >= 0x80) return c.text.size();
+        if(org.x + ((advance*hscale) >> 16) - m >= right) return i;
+        advance += metrics->advance(ch);
+    }
+    return c.text.size();
+}
+
+void display_list::_render(InputOutputArray img, const Command& c)
+{
+    using Kind = Command::Kind;
+    using Backend = image_ostream::Backend;
+    using Counter = render_stats::Counter;
+    const bool verify = image_ostream::_Debug.verify_backend;
+    if(c.kind == Kind::Text || c.kind == Kind::OutlinedText)
+    {
+        render_stats::add(Counter::lines);
+        render_stats::add(Counter::chars, (int64_t)c.text.size());
+    }
+    switch(c.kind)
+    {
+    case Kind::Text:
+    {
+        const render_stats::Timer drawing(Counter::textTicks);
+        if(c.backend == Backend::Atlas)
+        {
+            glyph_atlas* atlas = glyph_atlas::get(c.fontFace, c.fontScale, c.thickness, c.lineType);
+            if(atlas && (verify ?
+                    atlas->verifyText(img, c.text, c.org, c.color) :
+                    atlas->drawText(img, c.text, c.org, c.color)))
+                return;
+        }
+        render_stats::add(Counter::putTextCalls);
+        cv::putText(img, c.text, c.org, c.fontFace, c.fontScale, c.color, c.thickness, c.lineType, false);
+        return;
+    }
+    case Kind::OutlinedText:
+        // With Backend::Atlas, outline and text are composited in a single pass over the image
+        if(c.backend == Backend::Atlas)
+        {
+            const render_stats::Timer drawing(Counter::outlineTicks);
+            glyph_atlas* outline = glyph_atlas::get(c.fontFace, c.fontScale, c.thickness2, c.lineType);
+            glyph_atlas* text = glyph_atlas::get(c.fontFace, c.fontScale, c.thickness, c.lineType);
+            if(outline && text)
+            {
+                const std::vector<glyph_atlas::Layer> layers{
+                    {outline, c.text, c.org2, c.color2},
+                    {text, c.text, c.org, c.color}};
+                if(verify ?
+                        glyph_atlas::verifyLayers(img, layers) :
+                        glyph_atlas::drawLayers(img, layers))
+                    return;
+            }
+        }
+        render_stats::add(Counter::putTextCalls, 2);
+        {
+            const render_stats::Timer drawing(Counter::outlineTicks);
+            cv::putText(img, c.text, c.org2, c.fontFace, c.fontScale, c.color2, c.thickness2, c.lineType, false);
         }
-        else
         {
-            x2 += max_width;
+            const render_stats::Timer drawing(Counter::textTicks);
+            cv::putText(img, c.text, c.org, c.fontFace, c.fontScale, c.color, c.thickness, c.lineType, false);
         }
-        const int midline_adj = midline_adj_k * _offset / 2;
-        *_pTextbox = cv::Rect(
-              cv::Point(x1, _origin.y + midline_adj),
-              cv::Point(x2, _origin.y + midline_adj + _offset));
+        return;
+    case Kind::Rectangle:
+    {
+        const render_stats::Timer drawing(Counter::backgroundTicks);
+        render_stats::add(Counter::backgrounds);
+        cv::rectangle(img, c.org, c.org2, c.color, c.thickness, c.lineType);
+        return;
+    }
+    case Kind::Marker:
+        cv::drawMarker(img, c.org, c.color);
+        return;
+    }
+}
+
+cv::image_ostream::Debug cv::image_ostream::_Debug;
+
+#ifdef CV2_PUTTEXT_TRACE
+void image_ostream::_trace(char phase, unsigned decorations, const Rect& box) const
+{
+    static std::atomic<uint32_t> threads{0};
+    static thread_local const uint32_t thread = threads++;
+    const std::string_view text = _buf.view();
+    trace_buffer::Event event;
+    event.phase = phase;
+    event.ticks = cv::getTickCount();
+    event.thread = thread;
+    event.chars = (uint32_t)text.size();
+    event.lines = (uint32_t)std::count(text.begin(), text.end(), '\n') + 1;
+    event.fontFace = _fontFace;
+    event.fontScale = _fontScale;
+    event.thickness = _thickness;
+    event.decorations = decorations;
+    event.box = box;
+    // Cut before a UTF-8 continuation byte, so the JSON never gets half a code point
+    size_t n = std::min(text.size(), sizeof(event.text) - 1);
+    while(n > 0 && n < text.size() && ((uchar)text[n] & 0xC0) == 0x80) --n;
+    text.copy(event.text, n);
+    trace_buffer::record(event);
+}
+#endif
+
+image_ostream::~image_ostream()
+{
+    if(_drawing()){
+        _nextLine();
+    }
+}
+
+void image_ostream::_nextLine()
+{
+    const Backend backend = _backend_opt ? _backend_opt.value() : Backend::Stroke;
+    _nextLineWith([&]{ return _renderLines(_thickness, _textPass(backend)); });
+}
+
+text_layout image_ostream::_layoutBlock(int max_width, int offset, bool oneline) const
+{
+#define X(type, name, default_val) const type _##name = _##name##_opt ? _##name##_opt.value() : default_val;
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+    (void)_reverse; (void)_backend;
+    text_layout block;
+    block.textSize = cv::Size(max_width, offset); // Negative height allowed?
+    block.textbox = textbox(_origin, _align, _bottomLeftOrigin, oneline, max_width, offset);
+    block.origin = _origin;
+    return block;
+}
+
+text_layout image_ostream::_layout(int thickness) const
+{
+    std::vector<text_layout::Line> lines;
+    text_layout layout = _layoutLines(thickness, [&lines](const text_layout::Line& line){ lines.push_back(line); });
+    layout.lines = std::move(lines);
+    return layout;
+}
+
+Rect image_ostream::textbox(Point origin, TextAlign align, bool bottomLeftOrigin, bool oneline, int width, int offset)
+{
+    const int midline_adj_k = (bottomLeftOrigin ? 1 : -1)
+            * (oneline && align == TextAlign::Center ? 1 : 0);
+    // The constructor of 2 points does the math for us
+    int x1 = origin.x;
+    int x2 = origin.x;
+    if(align == TextAlign::Center)
+    {
+        x1 -= width / 2;
+        x2 += width / 2;
+    }
+    else if(align == TextAlign::Right)
+    {
+        x1 -= width;
     }
-    if(_pOrigin)
+    else
     {
-        _pOrigin->x = _origin.x;
-        _pOrigin->y = _origin.y;
+        x2 += width;
     }
+    const int midline_adj = midline_adj_k * offset / 2;
+    return cv::Rect(
+          cv::Point(x1, origin.y + midline_adj),
+          cv::Point(x2, origin.y + midline_adj + offset));
+}
+
+void image_ostream::_setResults(const text_layout& block)
+{
+    if(_pTextSize) *_pTextSize = block.textSize;
+    if(_pTextbox) *_pTextbox = block.textbox;
+    if(_pOrigin) *_pOrigin = block.origin;
+}
+
+std::vector<Size> text_layout::lineSizes() const
+{
+    std::vector<Size> sizes;
+    sizes.reserve(lines.size());
+    for(const Line& line : lines) sizes.emplace_back(line.size.width, line.advance);
+    return sizes;
 }
 
-image_ostream& image_ostream::operator<<(const image_ostream& new_settings)
+void image_ostream::_applySettings(const image_ostream& new_settings)
 {
-    // First, dump out the old string, with old format
-    _nextLine();
-    // Then, copy over the new settings
 #define X(type, name, default_val) _##name = new_settings._##name;
     CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
 #undef X
 #define X(type, name, default_val) if(new_settings._##name##_opt) _##name##_opt = new_settings._##name##_opt.value();
     CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
 #undef X
+    if(new_settings._displayList) _displayList = new_settings._displayList;
+    if(new_settings._damage) _damage = new_settings._damage;
     // And any string
-    _str << new_settings._str.str();
-    return *this;
+    _append(new_settings._buf.view());
 }
 
 image_ostream::image_ostream(
@@ -417,6 +3023,8 @@ image_ostream::image_ostream(
     , _pTextSize(nullptr)
     , _pTextbox(nullptr)
     , _pOrigin(nullptr)
+    , _displayList(nullptr)
+    , _damage(nullptr)
     , _offset(0)
 { (void)_;
 }
@@ -434,16 +3042,57 @@ image_ostream::image_ostream(const image_ostream& rhs)
     , _pTextSize(rhs._pTextSize)
     , _pTextbox(rhs._pTextbox)
     , _pOrigin(rhs._pOrigin)
+    , _displayList(rhs._displayList)
+    , _damage(rhs._damage)
+    , _offset(rhs._offset)
+    , _buf(rhs._buf)
+{
+}
+
+image_ostream::image_ostream(image_ostream&& rhs)
+    : _img(rhs._img)
+    , _origin(rhs._origin)
+#define X(type, name, default_val) , _##name(rhs._##name)
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+#undef X
+#define X(type, name, default_val) , _##name##_opt(rhs._##name##_opt)
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+    , _pLineSizes(rhs._pLineSizes)
+    , _pTextSize(rhs._pTextSize)
+    , _pTextbox(rhs._pTextbox)
+    , _pOrigin(rhs._pOrigin)
+    , _displayList(rhs._displayList)
+    , _damage(rhs._damage)
     , _offset(rhs._offset)
-    , _str(rhs._str.str())
+    , _buf(std::move(rhs._buf))
 {
+    if(rhs._stream) _ostream().copyfmt(*rhs._stream);
+    rhs._img = _InputOutputArray();
+    rhs._displayList = nullptr;
+    rhs._damage = nullptr;
+    rhs._pLineSizes = nullptr;
+    rhs._pTextSize = nullptr;
+    rhs._pTextbox = nullptr;
+    rhs._pOrigin = nullptr;
 }
 
+// Where putText_RelativeTo() puts the text: its origin, the align it sets (if any), and
+// bottomLeftOrigin, which reverse follows
+struct _RelativeTo
+{
+    Point origin;
+    std::optional<image_ostream::TextAlign> align;
+    bool bottomLeftOrigin;
+};
+
+static _RelativeTo _relativeToSide(const Point& rect_tl, const Size& rect_size,
+    image_ostream::TextAlign horz, image_ostream::VertAlign vert,
+    bool inside, bool textboxBottomLeftOrigin, int pad_x, int pad_y);
+
 // Put text on the top or bottom of the rectangle
-image_ostream putText_RelativeTo(
-    InputOutputArray img, const Point& rect_tl, const Size& rect_size,
-    image_ostream::VertAlign vert, image_ostream::TextAlign horz,
-    bool inside, int pad )
+static _RelativeTo _relativeTo(const Point& rect_tl, const Size& rect_size,
+    image_ostream::VertAlign vert, image_ostream::TextAlign horz, bool inside, int pad)
 {
     // Inside meaningless for Mid-Center
     using TA = image_ostream::TextAlign;
@@ -451,7 +3100,7 @@ image_ostream putText_RelativeTo(
     // The only case where text not within left/right sides
     // This fn: everything is inside of left/right sides
     if(vert == VA::Mid && horz != TA::Center && !inside)
-        return putText_RelativeTo(img, rect_tl, rect_size, horz, vert, inside, pad);
+        return _relativeToSide(rect_tl, rect_size, horz, vert, inside, pad != 0, 6, 0);
 
     const int x_pad = inside ? pad : 0; // Never pad if can't hit ref obj
     const int x = rect_tl.x + (
@@ -463,25 +3112,19 @@ image_ostream putText_RelativeTo(
         vert == VA::Top ? (inside ? pad : -pad) :
         vert == VA::Bottom ? rect_size.height + (inside ? -pad : pad) :
         /* Mid */ rect_size.height / 2 );
-    auto fmt = image_ostream(img, cv::Point(x, y));
-    fmt._align_opt = horz;
-    fmt._bottomLeftOrigin_opt = blOrigin;
-    // move the offset up, instead of down, such that whole text block has origin at bottomLeft
-    fmt._reverse_opt = blOrigin;
-    return fmt;
+    return _RelativeTo{cv::Point(x, y), horz, blOrigin};
 }
 
 // Put text on the left or right side of the rectangle
-image_ostream putText_RelativeTo(
-    InputOutputArray img, const Point& rect_tl, const Size& rect_size,
+static _RelativeTo _relativeToSide(const Point& rect_tl, const Size& rect_size,
     image_ostream::TextAlign horz, image_ostream::VertAlign vert,
-    bool inside, bool textboxBottomLeftOrigin, int pad_x, int pad_y )
+    bool inside, bool textboxBottomLeftOrigin, int pad_x, int pad_y)
 {
     using TA = image_ostream::TextAlign;
     using VA = image_ostream::VertAlign;
     // Only handle the outside cases here
     if(horz == TA::Center || inside)
-        return putText_RelativeTo(img, rect_tl, rect_size, vert, horz, inside, pad_x);
+        return _relativeTo(rect_tl, rect_size, vert, horz, inside, pad_x);
 
     const bool blOrigin = textboxBottomLeftOrigin;
     // Note: this x has opposite padding directions as other function, bc outside left/right
@@ -492,35 +3135,317 @@ image_ostream putText_RelativeTo(
         vert == VA::Top ? (blOrigin ? -pad_y : pad_y) :
         vert == VA::Bottom ? rect_size.height + (blOrigin ? -pad_y : pad_y) :
         /* Mid */ rect_size.height / 2 );
-    auto fmt = image_ostream(img, cv::Point(x, y));
+    std::optional<TA> align;
     if(horz == TA::Left)
-        fmt._align_opt = TA::Right; // flip
-    fmt._bottomLeftOrigin_opt = blOrigin;
+        align = TA::Right; // flip
+    return _RelativeTo{cv::Point(x, y), align, blOrigin};
+}
+
+static image_ostream _relativeToStream(InputOutputArray img, const _RelativeTo& at)
+{
+    auto fmt = image_ostream(img, at.origin);
+    if(at.align) fmt._align_opt = at.align;
+    fmt._bottomLeftOrigin_opt = at.bottomLeftOrigin;
     // move the offset up, instead of down, such that whole text block has origin at bottomLeft
-    fmt._reverse_opt = blOrigin;
+    fmt._reverse_opt = at.bottomLeftOrigin;
     return fmt;
 }
 
-void image_ostream::_reverseLines()
+image_ostream putText_RelativeTo(
+    InputOutputArray img, const Point& rect_tl, const Size& rect_size,
+    image_ostream::VertAlign vert, image_ostream::TextAlign horz,
+    bool inside, int pad )
+{
+    return _relativeToStream(img, _relativeTo(rect_tl, rect_size, vert, horz, inside, pad));
+}
+
+image_ostream putText_RelativeTo(
+    InputOutputArray img, const Point& rect_tl, const Size& rect_size,
+    image_ostream::TextAlign horz, image_ostream::VertAlign vert,
+    bool inside, bool textboxBottomLeftOrigin, int pad_x, int pad_y )
+{
+    return _relativeToStream(img, _relativeToSide(rect_tl, rect_size, horz, vert, inside, textboxBottomLeftOrigin, pad_x, pad_y));
+}
+
+// The streams of a batch, one per distinct style: Stream(label, args...) for a label of a new style
+template<typename Stream>
+struct _batchStreams
 {
-    std::string line;
-    std::vector<std::string> lines;
-    while(!std::getline(_str, line).eof())
+    template<typename Label, typename... Args>
+    Stream& get(const Label& label, const Args&... args)
     {
-        lines.push_back(std::move(line));
+        if(last && last->matches(label)) return *last;
+        for(Stream& s : streams)
+        {
+            if(s.matches(label)) return *(last = &s);
+        }
+        return *(last = &streams.emplace_back(label, args...));
+    }
+    std::deque<Stream> streams;
+    Stream* last = nullptr;
+};
+
+// Where stream's draw(target, label, ...) would reach: its commands' display_list::bounds(), as
+// culled, from a recording of them into list (cleared first; reused, it keeps its storage).
+// Sets textbox, as drawing would. With marker, the Debug::draw_origin marker's bounds go there
+// instead (it stays at the origin, whatever the align)
+template<typename Stream, typename Label>
+static Rect _inkBounds(display_list& list, Stream& stream, const Label& label, Rect* textbox, Rect* marker = nullptr)
+{
+    list.clear();
+    Mat none;
+    stream.displayList(&list);
+    stream.draw(none, label, Point(0, 0), textbox);
+    stream.displayList(nullptr);
+    if(!marker) return list.bounds();
+    Rect ink;
+    for(const display_list::Command& c : list.commands())
+        (c.kind == display_list::Command::Kind::Marker ? *marker : ink) |= display_list::bounds(c);
+    return ink;
+}
+
+// putTextBatch() of either header. Stream is an image_ostream(_fancy) for one style, with
+// draw(target, label, shift, textbox) drawing label at its origin - shift onto target (only
+// measuring if it's empty).
+//
+// Big batches are drawn in horizontal bands of the image, one cv::parallel_for_ task each.
+// Labels are recorded (_inkBounds()), and binned into the bands their ink touches. A band
+// draws its labels in order: one inside the band straight into the band's rows, one crossing a
+// band edge onto a scratch of its bounds, holding the band's rows, which are then copied back.
+// Every pixel is so drawn by one thread, in label order, as if by one serial draw of the label.
+template<typename Stream, typename Label, typename... Args>
+static void _drawBatch(InputOutputArray _img, const Label* labels, size_t count,
+    std::vector<Rect>* textboxes, const Args&... args)
+{
+    const int bandRows = 64;    // fewer bands than threads rather than thinner ones
+    const size_t minLabels = 64; // below, threads cost more than they save
+    if(textboxes) textboxes->assign(count, Rect());
+    if(_img.empty()) return;
+    Mat img = _img.getMat();
+    const int bands = std::min(cv::getNumThreads(), img.rows / bandRows);
+    if(bands < 2 || count < minLabels)
+    {
+        _batchStreams<Stream> streams;
+        for(size_t i = 0; i < count; ++i)
+            streams.get(labels[i], args...).draw(img, labels[i], Point(0, 0), textboxes ? &(*textboxes)[i] : nullptr);
+        return;
+    }
+
+    std::vector<Rect> bounds(count);
+    cv::parallel_for_(cv::Range(0, (int)count), [&](const cv::Range& range)
+    {
+        _batchStreams<Stream> streams;
+        display_list recorded;
+        for(int i = range.start; i < range.end; ++i)
+        {
+            if(labels[i].text.empty()) continue; // draws nothing
+            Stream& stream = streams.get(labels[i], args...);
+            bounds[i] = _inkBounds(recorded, stream, labels[i], textboxes ? &(*textboxes)[i] : nullptr) & Rect(Point(0, 0), img.size());
+        }
+    });
+
+    const int rows = (img.rows + bands - 1) / bands;
+    std::vector<std::vector<int>> binned(bands);
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(bounds[i].empty()) continue;
+        for(int b = bounds[i].y / rows; b <= (bounds[i].br().y - 1) / rows; ++b)
+            binned[b].push_back((int)i);
+    }
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range)
+    {
+        _batchStreams<Stream> streams;
+        Mat scratch;
+        for(int b = range.start; b < range.end; ++b)
+        {
+            const int y0 = b*rows, y1 = std::min(img.rows, y0 + rows);
+            Mat band = img.rowRange(y0, y1);
+            for(const int i : binned[b])
+            {
+                const Rect& box = bounds[i];
+                Stream& stream = streams.get(labels[i], args...);
+                if(box.y >= y0 && box.br().y <= y1)
+                {
+                    stream.draw(band, labels[i], Point(0, y0), nullptr);
+                    continue;
+                }
+                // Only the band's rows are copied back, so only those need the image under them
+                const Rect mine(box.x, std::max(box.y, y0), box.width, std::min(box.br().y, y1) - std::max(box.y, y0));
+                const Rect local(mine.tl() - box.tl(), mine.size());
+                scratch.create(box.size(), img.type());
+                scratch.setTo(Scalar::all(0));
+                img(mine).copyTo(scratch(local));
+                stream.draw(scratch, labels[i], box.tl(), nullptr);
+                scratch(local).copyTo(img(mine));
+            }
+        }
+    });
+}
+
+// The stream of putTextBatch() and placeLabels() for one text_style
+struct _textLabelStream : image_ostream
+{
+    _textLabelStream(const text_label& label)
+        : image_ostream(noArray(), Point(0, 0)
+#define X(type, name, default_val) , label.style.name
+        CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+        CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+        )
+        , style(label.style)
+    {}
+    bool matches(const text_label& label) const { return style == label.style; }
+    void draw(Mat& target, const text_label& label, Point shift, Rect* textbox)
+    {
+        _img = _InputOutputArray(target);
+        _origin = label.origin - shift;
+        _offset = 0;
+        _pTextbox = textbox;
+        _buf.assign(label.text);
+        _nextLine();
+    }
+    const text_style style;
+};
+
+void putTextBatch(InputOutputArray img, const text_label* labels, size_t count, std::vector<Rect>* textboxes)
+{
+    _drawBatch<_textLabelStream>(img, labels, count, textboxes);
+}
+
+// Boxes placed so far, binned into square cells, so a new box is only tested against its neighbours.
+// Each cell is a linked list through one array of entries, so binning a box allocates nothing
+// once the arrays have grown
+class _boxGrid
+{
+public:
+    _boxGrid(Size size, int cell)
+        : _cell(cell)
+        , _cols(std::max(1, (size.width + cell - 1) / cell))
+        , _rows(std::max(1, (size.height + cell - 1) / cell))
+        , _heads((size_t)_cols * _rows, -1)
+    {}
+    // Boxes must lie inside the grid's size
+    bool overlaps(const Rect& box) const
+    {
+        for(int r = box.y / _cell; r <= (box.br().y - 1) / _cell; ++r)
+            for(int c = box.x / _cell; c <= (box.br().x - 1) / _cell; ++c)
+                for(int e = _heads[(size_t)r * _cols + c]; e >= 0; e = _entries[e].next)
+                    if((_boxes[_entries[e].box] & box).area() > 0) return true;
+        return false;
     }
-    lines.push_back(std::move(line));
-    _str.str("");
-    _str.clear();
-    if(lines.empty()){ return; }
-    auto rit = lines.crbegin();
-    _str << *rit;
-    while(++rit != lines.crend())
+    void insert(const Rect& box)
+    {
+        const int i = (int)_boxes.size();
+        _boxes.push_back(box);
+        for(int r = box.y / _cell; r <= (box.br().y - 1) / _cell; ++r)
+            for(int c = box.x / _cell; c <= (box.br().x - 1) / _cell; ++c)
+            {
+                int& head = _heads[(size_t)r * _cols + c];
+                _entries.push_back(Entry{i, head});
+                head = (int)_entries.size() - 1;
+            }
+    }
+
+protected:
+    struct Entry
+    {
+        int box;
+        int next; // the cell's next entry, or -1
+    };
+    const int _cell;
+    const int _cols;
+    const int _rows;
+    std::vector<int> _heads; // per cell, its last entry, or -1
+    std::vector<Entry> _entries;
+    std::vector<Rect> _boxes;
+};
+
+// placeLabels() of either header. Stream is putTextBatch()'s for Placed (the label type);
+// Anchored holds an anchor, a Placed label and its placements. A placement is taken when its
+// Textbox lies inside the image, and its ink (_inkBounds()) clear of the labels placed before.
+// A label is measured once per layout its placements use, from its own origin, and each
+// placement only moves that: the layout is the align and bottomLeftOrigin (reverse follows it),
+// and a single line's right-aligned layout is its left-aligned one, moved left by its width.
+template<typename Stream, typename Anchored, typename Placed>
+static void _placeBatch(Size imgSize, const Anchored* labels, size_t count, std::vector<Placed>& placed,
+    std::vector<int>* chosen, const std::vector<label_placement>* placements, int pad)
+{
+    using TA = image_ostream::TextAlign;
+    using VA = image_ostream::VertAlign;
+    static const std::vector<label_placement> around{
+        {VA::Top, TA::Left, false}, {VA::Top, TA::Right, false},
+        {VA::Bottom, TA::Left, false}, {VA::Bottom, TA::Right, false},
+        {VA::Top, TA::Left, true}};
+    const std::vector<label_placement>& fallback = placements ? *placements : around;
+    if(chosen) chosen->assign(count, -1);
+    placed.reserve(placed.size() + count);
+
+    struct Layout
     {
-        _str << '\n' << *rit;
+        bool measured = false;
+        Rect ink, box, marker; // from the label's origin
+    };
+    const Rect image(Point(0, 0), imgSize);
+    _batchStreams<Stream> streams;
+    display_list recorded;
+    _boxGrid grid(imgSize, 64);
+    for(size_t i = 0; i < count; ++i)
+    {
+        const Anchored& a = labels[i];
+        if(a.label.text.empty()) continue;
+
+        Stream& stream = streams.get(a.label);
+        const bool oneline = a.label.text.find('\n') == std::string::npos;
+        Layout layouts[3][2]; // [align][bottomLeftOrigin]
+        const std::vector<label_placement>& options = a.placements.empty() ? fallback : a.placements;
+        for(size_t k = 0; k < options.size(); ++k)
+        {
+            const label_placement& p = options[k];
+            const _RelativeTo at = _relativeTo(a.anchor.tl(), a.anchor.size(), p.vert, p.horz, p.inside, pad);
+            const TA align = at.align.value_or(TA::Left);
+            const bool right = oneline && align == TA::Right;
+            Layout& layout = layouts[(int)(right ? TA::Left : align)][at.bottomLeftOrigin];
+            if(!layout.measured)
+            {
+                const auto own = std::make_tuple(stream._align_opt, stream._bottomLeftOrigin_opt, stream._reverse_opt);
+                stream._align_opt = right ? TA::Left : align;
+                stream._bottomLeftOrigin_opt = stream._reverse_opt = at.bottomLeftOrigin;
+                layout.ink = _inkBounds(recorded, stream, a.label, &layout.box, &layout.marker) - a.label.origin;
+                layout.box -= a.label.origin;
+                layout.marker -= a.label.origin;
+                std::tie(stream._align_opt, stream._bottomLeftOrigin_opt, stream._reverse_opt) = own;
+                layout.measured = true;
+            }
+            const Point shift = at.origin - Point(right ? layout.box.width : 0, 0);
+            const Rect box = layout.box + shift;
+            const Rect taken = ((layout.ink + shift) | (layout.marker + at.origin)) & image;
+            if((box & image) != box || grid.overlaps(taken)) continue;
+
+            grid.insert(taken);
+            Placed& label = placed.emplace_back(a.label);
+            label.origin = at.origin;
+            label.style.align = align;
+            label.style.bottomLeftOrigin = label.style.reverse = at.bottomLeftOrigin;
+            if(chosen) (*chosen)[i] = (int)k;
+            break;
+        }
     }
 }
 
+void placeLabels(Size imgSize, const anchored_label* labels, size_t count, std::vector<text_label>& placed,
+    std::vector<int>* chosen, const std::vector<label_placement>* placements, int pad)
+{
+    _placeBatch<_textLabelStream>(imgSize, labels, count, placed, chosen, placements, pad);
+}
+
+void putTextPlaced(InputOutputArray img, const anchored_label* labels, size_t count,
+    std::vector<int>* chosen, const std::vector<label_placement>* placements, int pad)
+{
+    std::vector<text_label> placed;
+    placeLabels(img.size(), labels, count, placed, chosen, placements, pad);
+    putTextBatch(img, placed);
+}
+
 void image_ostream::replaceAll(std::string& str, const std::string& from, const std::string& to) {
     // https://stackoverflow.com/a/3418285/
     if(from.empty())
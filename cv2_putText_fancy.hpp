@@ -74,7 +74,9 @@
 */
 
 #include <opencv2/core.hpp>
+#include <cstring>
 #include <optional>
+#include <type_traits>
 
 #if defined(CV2_PUTTEXT_FANCY_HPP_IMPL) && !defined(CV2_PUTTEXT_HPP_IMPL)
 #define CV2_PUTTEXT_HPP_IMPL
@@ -111,6 +113,83 @@ namespace cv {
   X(bool, bgFilled, true) \
   X(bool, bgBaselinePad, true)
 
+//! Cache of fully composed labels (background, outline/shadow and text), for overlays that
+//! draw the same text in the same style every frame, at different positions.
+//! A label is composed once, offscreen, and stored as a coverage mask over a color layer;
+//! repeats are a single blit at the new origin. Labels are evicted least recently used first
+//! once their bytes exceed the budget.
+//! Exact labels (every pixel either untouched or overwritten, as with LINE_4/LINE_8) blit to
+//! the same pixels as drawing them. Anti-aliased pixels depend on what's underneath, so by
+//! default labels with any are drawn normally; setExact(false) caches them too, re-blending
+//! those pixels from their coverage (within a couple of levels of a fresh draw).
+class CV_EXPORTS label_cache
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;     // labels blitted from the cache
+        size_t misses = 0;   // labels composed and inserted
+        size_t bypasses = 0; // labels drawn normally: anti-aliased, or against the image border
+        size_t entries = 0;
+        size_t bytes = 0;
+        size_t budget = 0;
+        double hitRate() const { return hits + misses + bypasses ? (double)hits/(hits + misses + bypasses) : 0; }
+    };
+
+    //! A composed label, relative to the pen (origin, moved down by the lines before it)
+    struct Label
+    {
+        bool cacheable = false; // false: draw normally, every time
+        bool exact = true;      // mask is only 0 or 255
+        Mat mask;               // CV_8UC1 coverage
+        Mat color;              // in the image's type; valid where mask is non-zero
+        Point offset;           // of mask, from the pen
+        // What drawing it does to the stream
+        int advance = 0;        // of the pen (image_ostream::_offset)
+        int maxWidth = 0;
+        std::vector<Size> lineSizes;
+    };
+
+    explicit label_cache(size_t budgetBytes = 32 << 20);
+
+    //! nullptr if key isn't cached; counts nothing
+    std::shared_ptr<const Label> find(const std::string& key);
+    //! Labels larger than the whole budget are not kept
+    void insert(const std::string& key, std::shared_ptr<const Label> label);
+    //! Composites label with its pen at pen; the caller keeps it inside img
+    static void blit(InputOutputArray img, const Label& label, Point pen);
+
+    void countHit();
+    void countMiss();
+    void countBypass();
+
+    Stats stats() const;
+    void resetStats();
+    void clear();
+    void setBudget(size_t budgetBytes);
+    bool exact() const { return _exact; }
+    void setExact(bool exact);
+
+protected:
+    struct Entry
+    {
+        std::string key;
+        std::shared_ptr<const Label> label;
+        size_t bytes;
+    };
+    typedef std::list<Entry>::iterator EntryIt;
+
+    void _evict(size_t budget);
+
+    mutable std::mutex _mutex;
+    size_t _budget;
+    size_t _bytes;
+    bool _exact;
+    std::list<Entry> _lru; // front is most recently used
+    std::unordered_map<std::string, EntryIt> _index;
+    Stats _stats;
+};
+
 //! Creates and return image_ostream_fancy object to render text on the image like the std::cout does.
 //! An image_ostream_fancy class supports operator<< for both primitive and opencv types.
 class CV_EXPORTS image_ostream_fancy : public cv::image_ostream
@@ -127,10 +206,13 @@ public:
 #undef X
         void*_=0);
 
-    //! Copy constructor is necessary because compiler cannot perform RVO in putText() function in some cases. To deal with it we introduce copy
-    //! constructor which copies image_ostream_fancy object and it's internal string buffer.
+    //! Copies the settings and the pending text; both copies will draw it
     image_ostream_fancy(const image_ostream_fancy&);
     image_ostream_fancy(const image_ostream&);
+    //! Takes everything from rhs, which is left to draw nothing; see image_ostream(image_ostream&&)
+    image_ostream_fancy(image_ostream_fancy&&);
+    //! From a regular stream (like putText_RelativeTo()), with default fancy settings
+    image_ostream_fancy(image_ostream&&);
 
     //! Prints everything to the cv::Mat in the destructor
     ~image_ostream_fancy();
@@ -143,14 +225,14 @@ public:
     template <typename T>
     image_ostream_fancy& operator<<(const T& x)
     {
-        _str << x;
+        _insert(x);
         return *this;
     }
 
     //! Define an operator<< to take in std::endl and other manipulators
     inline image_ostream_fancy& operator<<(ManipType manip)
     {
-        manip(_str);
+        _insert(manip);
         return *this;
     }
 
@@ -168,14 +250,39 @@ public:
 #define X(type, name, default_val) inline image_ostream_fancy& name(std::optional<type> const x){ _##name##_opt = x; return *this; }
     CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
 #undef X
+    //! Blit repeated labels from cache (nullptr: draw every time); see label_cache
+    inline image_ostream_fancy& labelCache(label_cache* const cache){ _labelCache = cache; return *this; }
+    //! Record the draws into list instead of drawing them (any image is ignored); see display_list
+    inline image_ostream_fancy& displayList(display_list* const list){ _displayList = list; return *this; }
+    //! Add the bounds of the pixels drawing changes to region; see damage_region
+    inline image_ostream_fancy& damage(damage_region* const region){ _damage = region; return *this; }
+
+    //! Lays out the pending text, as it would be drawn next, without drawing or consuming it
+    text_layout layout() const { return _layout(_maxThickness()); }
 
 protected:
-    // Does not handle newlines!
-    cv::Size _getLineSize(const std::string& text, int& baseline) const
+    void _nextLine();
+    // Draws (or measures, with no image) the lines of _buf, advancing _offset; returns the block.
+    // _renderLines() with the fancy passes: the background, then the text with its outline or shadow
+    text_layout _drawLines();
+    // What style draws besides the text, as trace_buffer::Decoration bits
+    unsigned _decorations() const
     {
-        return cv::getTextSize(text, _fontFace, _fontScale, _maxThickness(), &baseline);
+        return (_outlined() ? 1u : 0u) | (_shadow ? 2u : 0u) | (_bgColor ? 4u : 0u);
     }
-    void _nextLine();
+    bool _outlined() const { return _outlineColor && _outlineThickness > 0; }
+    // The background pass: the line's box, with a _bgColor
+    auto _backgroundPass(bool oneline);
+    // The text pass: when outlined, the outline (or shadow) under the text, as one command, so
+    // the atlas composites both in a single pass; otherwise, image_ostream's
+    auto _outlinedTextPass(Backend backend);
+    // Blits the label from _labelCache, composing it on a miss; false to draw normally
+    bool _drawCachedLabel(int& max_width);
+    std::shared_ptr<const label_cache::Label> _composeLabel() const;
+    std::string _labelKey() const;
+    // Draws the outline (or shadow) at outlineOrg under the text at org.
+    // With Backend::Atlas both are composited in a single pass over the image.
+    void _putTextOutlined(const std::string& line, cv::Point org, cv::Point outlineOrg, Backend backend);
     int _maxThickness() const
     {
         return (_outlineColor && (_outlineThickness > 0) && !_shadow) ?
@@ -186,8 +293,19 @@ public:
 #define X(type, name, default_val) type _##name;
     CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
 #undef X
+    label_cache* _labelCache;
 };
 
+//! Continues lhs as a fancy stream, with rhs's settings. lhs is moved into the result, pending
+//! text and all, so that text is drawn once, by the result; lhs draws nothing after
+static inline image_ostream_fancy operator<<(image_ostream&& lhs, const image_ostream_fancy& rhs)
+{
+    image_ostream_fancy fancy_settings(std::move(lhs));
+    fancy_settings << rhs;
+    return fancy_settings;
+}
+//! A named stream (or saved format) is copied instead, like the copy constructor: both copies
+//! keep its text, and lhs goes on drawing
 static inline image_ostream_fancy operator<<(const image_ostream& lhs, const image_ostream_fancy& rhs)
 {
     image_ostream_fancy fancy_settings(lhs);
@@ -267,7 +385,8 @@ static inline image_ostream_fancy putTextBackground(
     cv::LineTypes lineType = cv::LINE_8, \
     std::optional<bool> bottomLeftOrigin = std::nullopt, \
     std::optional<image_ostream::TextAlign> align = std::nullopt, \
-    std::optional<bool> reverse = std::nullopt
+    std::optional<bool> reverse = std::nullopt, \
+    std::optional<image_ostream::Backend> backend = std::nullopt
 #define OPT_ALL_DEF
 
 /* v1.2.1: Conflicting ambiguous overload with image_ostream::putText()
@@ -371,137 +490,435 @@ static inline image_ostream_fancy putTextFancy_RelativeTo(
         horz, vert, inside, textboxBottomLeftOrigin, pad_x, pad_y);
 }
 
+//! The fancy settings of an image_ostream_fancy as plain values
+struct CV_EXPORTS fancy_style
+{
+#define X(type, name, default_val) type name = default_val;
+    CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+#undef X
+
+    bool operator==(const fancy_style& rhs) const
+    {
+        return true
+#define X(type, name, default_val) && name == rhs.name
+            CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+#undef X
+            ;
+    }
+};
+
+//! One label of putTextBatch(): cv::putTextFancy(img, origin, fancy..., style...) << text,
+//! or without fancy, cv::putText(img, origin, style...) << text
+struct CV_EXPORTS fancy_label
+{
+    Point origin;
+    std::string text;
+    text_style style;
+    std::optional<fancy_style> fancy;
+};
+
+//! As the cv2_putText.hpp putTextBatch(), for fancy labels: same pixels as the chain of
+//! putTextFancy()/putText() calls, with a stream per (style, fancy style), and likewise
+//! drawn in parallel bands when big enough.
+//! With a cache, every label is drawn through it, as with .labelCache(cache).
+CV_EXPORTS void putTextBatch(InputOutputArray img, const fancy_label* labels, size_t count,
+    std::vector<Rect>* textboxes = nullptr, label_cache* cache = nullptr);
+
+static inline void putTextBatch(InputOutputArray img, const std::vector<fancy_label>& labels,
+    std::vector<Rect>* textboxes = nullptr, label_cache* cache = nullptr)
+{
+    putTextBatch(img, labels.data(), labels.size(), textboxes, cache);
+}
+
+//! As anchored_label, for a fancy_label
+struct CV_EXPORTS anchored_fancy_label
+{
+    Rect anchor;
+    fancy_label label;
+    std::vector<label_placement> placements;
+};
+
+//! As the cv2_putText.hpp placeLabels(); labels keep clear of each other's outline, shadow
+//! and background too
+CV_EXPORTS void placeLabels(Size imgSize, const anchored_fancy_label* labels, size_t count,
+    std::vector<fancy_label>& placed, std::vector<int>* chosen = nullptr,
+    const std::vector<label_placement>* placements = nullptr, int pad = 6);
+
+//! placeLabels(), then putTextBatch() of the placed labels
+CV_EXPORTS void putTextPlaced(InputOutputArray img, const anchored_fancy_label* labels, size_t count,
+    std::vector<int>* chosen = nullptr, const std::vector<label_placement>* placements = nullptr, int pad = 6,
+    label_cache* cache = nullptr);
+
+static inline void putTextPlaced(InputOutputArray img, const std::vector<anchored_fancy_label>& labels,
+    std::vector<int>* chosen = nullptr, const std::vector<label_placement>* placements = nullptr, int pad = 6,
+    label_cache* cache = nullptr)
+{
+    putTextPlaced(img, labels.data(), labels.size(), chosen, placements, pad, cache);
+}
+
 #ifdef CV2_PUTTEXT_FANCY_HPP_IMPL
 
+label_cache::label_cache(size_t budgetBytes)
+    : _budget(budgetBytes)
+    , _bytes(0)
+    , _exact(true)
+{
+}
+
+std::shared_ptr<const label_cache::Label> label_cache::find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto found = _index.find(key);
+    if(found == _index.end()) return nullptr;
+    _lru.splice(_lru.begin(), _lru, found->second);
+    return found->second->label;
+}
+
+void label_cache::insert(const std::string& key, std::shared_ptr<const Label> label)
+{
+    const size_t bytes = key.size() + sizeof(Label)
+        + label->mask.total()*label->mask.elemSize()
+        + label->color.total()*label->color.elemSize()
+        + label->lineSizes.size()*sizeof(Size);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(bytes > _budget || _index.count(key)) return;
+    _evict(_budget - bytes);
+    _lru.push_front(Entry{key, std::move(label), bytes});
+    _index.emplace(key, _lru.begin());
+    _bytes += bytes;
+}
+
+void label_cache::blit(InputOutputArray _img, const Label& label, Point pen)
+{
+    if(label.mask.empty()) return;
+    Mat img = _img.getMat();
+    Mat roi = img(Rect(pen + label.offset, label.mask.size()));
+    if(label.exact)
+    {
+        label.color.copyTo(roi, label.mask);
+        return;
+    }
+    // Anti-aliased: blend by coverage, rounded like mask_blend
+    CV_Assert(img.depth() == CV_8U);
+    const int cn = img.channels();
+    for(int y = 0; y < roi.rows; ++y)
+    {
+        const uchar* mask = label.mask.ptr(y);
+        const uchar* color = label.color.ptr(y);
+        uchar* dst = roi.ptr(y);
+        for(int x = 0; x < roi.cols; ++x, color += cn, dst += cn)
+        {
+            const int a = mask[x];
+            if(!a) continue;
+            for(int k = 0; k < cn; ++k)
+            {
+                const int t = dst[k]*(255 - a) + color[k]*a + 128;
+                dst[k] = (uchar)((t + (t >> 8)) >> 8);
+            }
+        }
+    }
+}
+
+void label_cache::countHit()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats.hits;
+}
+
+void label_cache::countMiss()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats.misses;
+}
+
+void label_cache::countBypass()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats.bypasses;
+}
+
+label_cache::Stats label_cache::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats s = _stats;
+    s.entries = _index.size();
+    s.bytes = _bytes;
+    s.budget = _budget;
+    return s;
+}
+
+void label_cache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats = Stats();
+}
+
+void label_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _evict(0);
+}
+
+void label_cache::setBudget(size_t budgetBytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _budget = budgetBytes;
+    _evict(_budget);
+}
+
+void label_cache::setExact(bool exact)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(exact != _exact) _evict(0); // labels were composed for the other mode
+    _exact = exact;
+}
+
+void label_cache::_evict(size_t budget)
+{
+    while(_bytes > budget && !_lru.empty())
+    {
+        _bytes -= _lru.back().bytes;
+        _index.erase(_lru.back().key);
+        _lru.pop_back();
+    }
+}
+
 image_ostream_fancy::~image_ostream_fancy()
 {
-    if(!_img.empty()){
+    if(_drawing()){
         _nextLine();
     }
 }
 
 void image_ostream_fancy::_nextLine()
 {
-#define X(type, name, default_val) const type _##name = _##name##_opt ? _##name##_opt.value() : default_val;
-    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
-#undef X
-    if(_str.str().empty()){ return; }
-    if(_reverse){ _reverseLines(); }
-    if(_Debug.draw_origin) cv::drawMarker(_img, _origin, cv::Scalar(0, 0, 255));
-
-    const bool oneline = _str.str().find('\n') == std::string::npos;
-    const int shadow_offset = _shadow ? _outlineThickness : 0;
-    const int midline_adj_k = (_bottomLeftOrigin ? 1 : -1)
-            * (oneline && _align == TextAlign::Center ? 1 : 0);
-    const auto with_space = [c = _lineSpacing](int x) -> int { return (int)std::rint(c * x); };
-    const auto with_scale = [c = _fontScale](int x) -> int { return (int)std::rint(c * x); };
-
-    std::string line;
-    int max_width = 0;
-    do
+    _nextLineWith([this]
     {
-        std::getline(_str, line);
-        replaceAll(line, "\t", "  ");
-
-        // baseline is the distance from the line letters are written on
-        // to the bottom of characters that go below the line, like 'g' or 'y'
-        // height without baseline will cover 'ABC' but not 'g'
-        int baseline;
-        const cv::Size textSize = _getLineSize(line, baseline);
-
-        const int line_width = line.empty() ? 0 : textSize.width;
-        const int line_height = textSize.height + baseline;
-        // Note: we shift textSize.height to make the origin the upper-left corner
-        const int offset_adj = (_bottomLeftOrigin ? 0 : textSize.height);
-        const int midline_adj = midline_adj_k * textSize.height / 2;
-        const int offset_height = (int)std::rint(line_height * _lineSpacing) * (_reverse ? -1 : 1);
-        const int alignment_shift =
-            _align == TextAlign::Center ? -line_width / 2 :
-            _align == TextAlign::Right  ? -line_width :
-            /* _align == Left */ 0;
-
-        if(_pLineSizes) _pLineSizes->emplace_back(line_width, offset_height);
-        if(line_width > max_width) max_width = line_width;
-
-        if(line.empty()){
-            _offset += offset_height;
-            continue;
-        }
+        int max_width = 0;
+        return _labelCache && !_img.empty() && !_displayList && _drawCachedLabel(max_width) ?
+            _layoutBlock(max_width, _offset, _buf.view().find('\n') == std::string_view::npos) :
+            _drawLines();
+    }, [this]{ return _decorations(); });
+}
 
-        // Background mask
-        if(_bgColor && line_width > 0){
-            const int _pad = 6;
-            const int top_baseline_pad = _bgBaselinePad ?
-                (!oneline ? with_space(baseline / 2) : baseline / 2) :
-                with_scale(_pad);
-            const int bot_line_height = _bgBaselinePad ?
-                (!oneline ? with_space(line_height) : line_height) :
-                textSize.height + with_scale(_pad);
-            // pad with the top-baseline space; added to mirror the baseline underneath
-            //_offset += topBaselinePad;
-            const int rev_mag = _reverse ? -1 : 1; // This isn't a perf fit, but it's a start
-            cv::rectangle(_img,
-                origin(with_scale(-_pad) + alignment_shift,
-                    _offset + midline_adj - top_baseline_pad * rev_mag),
-                origin(with_scale(_pad) + alignment_shift + line_width,
-                    _offset + midline_adj + bot_line_height * rev_mag),
-                _bgColor.value(), _bgFilled ? cv::FILLED : 2, cv::LINE_AA);
-        }
+auto image_ostream_fancy::_backgroundPass(bool oneline)
+{
+    return [this, oneline, reverse = _reverse_opt.value_or(false)](const text_layout::Line& line)
+    {
+        const int line_width = line.size.width;
+        if(!_bgColor || line_width <= 0) return;
+        const int line_height = line.size.height + line.baseLine;
+        const auto with_space = [c = _lineSpacing](int x) -> int { return (int)std::rint(c * x); };
+        const auto with_scale = [c = _fontScale](int x) -> int { return (int)std::rint(c * x); };
+        const int _pad = 6;
+        const int top_baseline_pad = _bgBaselinePad ?
+            (!oneline ? with_space(line.baseLine / 2) : line.baseLine / 2) :
+            with_scale(_pad);
+        const int bot_line_height = _bgBaselinePad ?
+            (!oneline ? with_space(line_height) : line_height) :
+            line.size.height + with_scale(_pad);
+        // pad with the top-baseline space; added to mirror the baseline underneath
+        //_offset += topBaselinePad;
+        const int rev_mag = reverse ? -1 : 1; // This isn't a perf fit, but it's a start
+        Command bg;
+        bg.kind = Command::Kind::Rectangle;
+        bg.org = line.at + cv::Point(with_scale(-_pad), -top_baseline_pad * rev_mag);
+        bg.org2 = line.at + cv::Point(with_scale(_pad) + line_width, bot_line_height * rev_mag);
+        bg.color = _bgColor.value();
+        bg.thickness = _bgFilled ? cv::FILLED : 2;
+        bg.lineType = cv::LINE_AA;
+        _draw(std::move(bg));
+    };
+}
 
-        // Outline text
-        if(_outlineColor && _outlineThickness > 0){
-            cv::putText(_img, line,
-                origin(alignment_shift + shadow_offset,
-                    _offset + offset_adj + midline_adj + shadow_offset),
-                _fontFace, _fontScale, _outlineColor.value(), _maxThickness(),
-                _lineType, false);
-        }
+auto image_ostream_fancy::_outlinedTextPass(Backend backend)
+{
+    const int shadow_offset = _shadow ? _outlineThickness : 0;
+    return [this, outlined = _outlined(), backend, shadow_offset, text = _textPass(backend)](const text_layout::Line& line)
+    {
+        if(!outlined) return text(line);
+        _putTextOutlined(line.text, line.org, line.org + cv::Point(shadow_offset, shadow_offset), backend);
+    };
+}
 
-        // Real text
-        cv::putText(_img, line,
-            origin(alignment_shift, _offset + offset_adj + midline_adj),
-            _fontFace, _fontScale, _color, _thickness,
-            _lineType, false);
+text_layout image_ostream_fancy::_drawLines()
+{
+    const Backend backend = _backend_opt ? _backend_opt.value() : Backend::Stroke;
+    const bool oneline = _buf.view().find('\n') == std::string_view::npos;
+    return _renderLines(_maxThickness(), _backgroundPass(oneline), _outlinedTextPass(backend));
+}
 
-        _offset += offset_height;
-    } while (!_str.eof());
+bool image_ostream_fancy::_drawCachedLabel(int& max_width)
+{
+    const std::string key = _labelKey();
+    std::shared_ptr<const label_cache::Label> label = _labelCache->find(key);
+    const bool hit = (bool)label;
+    if(!hit)
+    {
+        label = _composeLabel();
+        _labelCache->insert(key, label);
+    }
 
-    _str.str("");
-    _str.clear();
+    // cv::putText() clips strokes at the border differently than a clipped blit would
+    const cv::Point pen = origin(0, _offset);
+    const cv::Rect box(pen + label->offset, label->mask.size());
+    const cv::Size imgSize = _img.size();
+    const cv::Rect inside(1, 1, imgSize.width - 2, imgSize.height - 2);
+    if(!label->cacheable || (!box.empty() && (box & inside) != box))
+    {
+        hit ? _labelCache->countBypass() : _labelCache->countMiss();
+        return false;
+    }
+    hit ? _labelCache->countHit() : _labelCache->countMiss();
 
-    if(_pTextSize)
+    if(_damage)
     {
-        _pTextSize->width = max_width;
-        _pTextSize->height = _offset; // Negative allowed?
+        const cv::Mat img = _img.getMat();
+        _damage->track(img, box, [&img, &label, &pen](){ label_cache::blit(img, *label, pen); });
     }
-    if(_pTextbox)
+    else
     {
-        // The constructor of 2 points does the math for us
-        int x1 = _origin.x;
-        int x2 = _origin.x;
-        if(_align == TextAlign::Center)
+        label_cache::blit(_img, *label, pen);
+    }
+    _offset += label->advance;
+    max_width = label->maxWidth;
+    if(_pLineSizes) _pLineSizes->insert(_pLineSizes->end(), label->lineSizes.begin(), label->lineSizes.end());
+    return true;
+}
+
+std::string image_ostream_fancy::_labelKey() const
+{
+    // Everything that decides the pixels: the image type, every setting, and the text
+    std::string key;
+    const auto append = [&key](const auto& x)
+    {
+        using T = std::decay_t<decltype(x)>;
+        if constexpr(std::is_same_v<T, std::optional<Scalar>>)
         {
-            x1 -= max_width / 2;
-            x2 += max_width / 2;
+            const Scalar value = x.value_or(Scalar::all(-1));
+            key.push_back((char)x.has_value());
+            key.append((const char*)&value, sizeof(value));
         }
-        else if(_align == TextAlign::Right)
+        else
         {
-            x1 -= max_width;
+            key.append((const char*)&x, sizeof(x));
         }
-        else
+    };
+    append(_img.type());
+#define X(type, name, default_val) append(_##name);
+    CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+#undef X
+#define X(type, name, default_val) append(_##name##_opt ? _##name##_opt.value() : default_val);
+    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+    key.append(_buf.view());
+    return key;
+}
+
+std::shared_ptr<const label_cache::Label> image_ostream_fancy::_composeLabel() const
+{
+    auto label = std::make_shared<label_cache::Label>();
+    const std::string_view text = _buf.view();
+    const auto probe = [&](cv::InputOutputArray canvas, cv::Point pen, std::vector<cv::Size>* lineSizes)
+    {
+        image_ostream_fancy s(canvas, pen
+#define X(type, name, default_val) , _##name
+            CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+            CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+#undef X
+#define X(type, name, default_val) , _##name##_opt
+            CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+            );
+        s._buf.assign(text);
+        s._pLineSizes = lineSizes;
+        const int max_width = s._drawLines().textSize.width;
+        const int advance = s._offset;
+        s._buf.clear(); // nothing left for the destructor
+        return std::make_pair(max_width, advance);
+    };
+
+    // Measure, then draw the label on a canvas with room for the background pad, outline and
+    // shadow around its lines, once on each of three backgrounds
+    std::tie(label->maxWidth, label->advance) = probe(cv::noArray(), cv::Point(0, 0), &label->lineSizes);
+    int line_height = 0;
+    for(const cv::Size& size : label->lineSizes) line_height = std::max(line_height, std::abs(size.height));
+    const int margin = 2*(_maxThickness() + _outlineThickness) + cvCeil(_fontScale*8) + 16;
+    const cv::Point pen(label->maxWidth + margin, std::abs(label->advance) + line_height + margin);
+    const cv::Size canvasSize(2*pen.x + 1, 2*pen.y + 1);
+    const double backgrounds[3] = {0, 255, 128};
+    cv::Mat canvas[3], bg[3];
+    for(int i = 0; i < 3; ++i)
+    {
+        canvas[i] = cv::Mat(canvasSize, _img.type(), cv::Scalar::all(backgrounds[i]));
+        bg[i] = cv::Mat(1, 1, _img.type(), cv::Scalar::all(backgrounds[i]));
+        probe(canvas[i], pen, nullptr);
+    }
+
+    // Untouched pixels kept each background; overwritten ones have the same value on all three
+    const size_t esz = canvas[0].elemSize();
+    const bool blendable = !_labelCache->exact() && canvas[0].depth() == CV_8U;
+    cv::Mat mask = cv::Mat::zeros(canvasSize, CV_8UC1);
+    cv::Mat color = canvas[0];
+    bool exact = true;
+    for(int y = 0; y < canvasSize.height; ++y)
+    {
+        const uchar* p[3] = {canvas[0].ptr(y), canvas[1].ptr(y), canvas[2].ptr(y)};
+        uchar* m = mask.ptr(y);
+        uchar* c = color.ptr(y);
+        for(int x = 0; x < canvasSize.width; ++x, p[0] += esz, p[1] += esz, p[2] += esz, c += esz)
         {
-            x2 += max_width;
+            if(!std::memcmp(p[0], bg[0].ptr(), esz) && !std::memcmp(p[1], bg[1].ptr(), esz) &&
+                    !std::memcmp(p[2], bg[2].ptr(), esz))
+                continue;
+            if(!std::memcmp(p[0], p[1], esz) && !std::memcmp(p[0], p[2], esz))
+            {
+                m[x] = 255;
+                continue;
+            }
+            exact = false;
+            if(!blendable) return label; // not cacheable
+            // Blended: p0 = color*a, p255 = color*a + 255*(1 - a)
+            int a = 255;
+            for(size_t k = 0; k < esz; ++k) a = std::min(a, 255 - (p[1][k] - p[0][k]));
+            a = std::max(a, 1);
+            m[x] = (uchar)a;
+            for(size_t k = 0; k < esz; ++k) c[k] = cv::saturate_cast<uchar>(p[0][k]*255.0/a);
         }
-        const int midline_adj = midline_adj_k * _offset / 2;
-        *_pTextbox = cv::Rect(
-              cv::Point(x1, _origin.y + midline_adj),
-              cv::Point(x2, _origin.y + midline_adj + _offset));
     }
-    if(_pOrigin)
+
+    const cv::Rect ink = cv::boundingRect(mask);
+    if(ink.area() > 0 && (ink.x == 0 || ink.y == 0 ||
+            ink.br().x == canvasSize.width || ink.br().y == canvasSize.height))
+        return label; // ran off the canvas; not cacheable
+    label->cacheable = true;
+    label->exact = exact;
+    if(ink.area() > 0)
     {
-        _pOrigin->x = _origin.x;
-        _pOrigin->y = _origin.y;
+        label->mask = mask(ink).clone();
+        label->color = color(ink).clone();
+        label->offset = ink.tl() - pen;
     }
+    return label;
+}
+
+void image_ostream_fancy::_putTextOutlined(const std::string& line, cv::Point org, cv::Point outlineOrg, Backend backend)
+{
+    Command command;
+    command.kind = Command::Kind::OutlinedText;
+    command.text = line;
+    command.org = org;
+    command.org2 = outlineOrg;
+    command.color = _color;
+    command.color2 = _outlineColor.value();
+    command.thickness = _thickness;
+    command.thickness2 = _maxThickness();
+    command.fontFace = _fontFace;
+    command.fontScale = _fontScale;
+    command.lineType = _lineType;
+    command.backend = backend;
+    _draw(std::move(command));
 }
 
 image_ostream_fancy& image_ostream_fancy::operator<<(const image_ostream_fancy& new_settings)
@@ -511,19 +928,21 @@ image_ostream_fancy& image_ostream_fancy::operator<<(const image_ostream_fancy&
     // Then, copy over the new settings
 #define X(type, name, default_val) _##name = new_settings._##name;
     CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
-    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
-#undef X
-#define X(type, name, default_val) if(new_settings._##name##_opt) _##name##_opt = new_settings._##name##_opt.value();
-    CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
 #undef X
-    // And any string
-    _str << new_settings._str.str();
+    // Its label cache too, like its display list and damage region
+    if(new_settings._labelCache) _labelCache = new_settings._labelCache;
+    _applySettings(new_settings);
     return *this;
 }
 
 image_ostream_fancy& image_ostream_fancy::operator<<(const image_ostream& new_settings)
 {
-    *this << image_ostream_fancy(new_settings);
+    // As a fancy stream of new_settings, with default fancy settings, without making one
+    _nextLine();
+#define X(type, name, default_val) _##name = default_val;
+    CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+#undef X
+    _applySettings(new_settings);
     return *this;
 }
 
@@ -546,6 +965,7 @@ image_ostream_fancy::image_ostream_fancy(
 #define X(type, name, default_val) , _##name(name)
     CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
 #undef X
+    , _labelCache(nullptr)
 { (void)_;
 }
 
@@ -554,6 +974,7 @@ image_ostream_fancy::image_ostream_fancy(const image_ostream_fancy& rhs)
 #define X(type, name, default_val) , _##name(rhs._##name)
     CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
 #undef X
+    , _labelCache(rhs._labelCache)
 {
 }
 
@@ -562,22 +983,87 @@ image_ostream_fancy::image_ostream_fancy(const image_ostream& rhs)
 #define X(type, name, default_val) , _##name(default_val)
     CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
 #undef X
+    , _labelCache(nullptr)
+{
+}
+
+image_ostream_fancy::image_ostream_fancy(image_ostream_fancy&& rhs)
+    : image_ostream(std::move(rhs))
+#define X(type, name, default_val) , _##name(rhs._##name)
+    CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+#undef X
+    , _labelCache(rhs._labelCache)
+{
+}
+
+image_ostream_fancy::image_ostream_fancy(image_ostream&& rhs)
+    : image_ostream(std::move(rhs))
+#define X(type, name, default_val) , _##name(default_val)
+    CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+#undef X
+    , _labelCache(nullptr)
+{
+}
+
+// The stream of putTextBatch() and placeLabels() for one (text_style, fancy_style).
+// Without fancy settings, image_ostream_fancy draws exactly as image_ostream
+struct _fancyLabelStream : image_ostream_fancy
+{
+    _fancyLabelStream(const fancy_label& label, label_cache* cache = nullptr)
+        : image_ostream_fancy(noArray(), Point(0, 0)
+#define X(type, name, default_val) , label.fancy.value_or(fancy_style()).name
+        CV2_PUTTEXT_FANCY_HPP__IMAGE_OSTREAM_FANCY_VAR_ARGS_X
+#undef X
+#define X(type, name, default_val) , label.style.name
+        CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_X
+        CV2_PUTTEXT_HPP__IMAGE_OSTREAM_VAR_ARGS_OPT_X
+#undef X
+        )
+        , style(label.style)
+        , fancy(label.fancy.value_or(fancy_style()))
+    {
+        _labelCache = cache;
+    }
+    bool matches(const fancy_label& label) const
+    {
+        return style == label.style && fancy == label.fancy.value_or(fancy_style());
+    }
+    void draw(Mat& target, const fancy_label& label, Point shift, Rect* textbox)
+    {
+        _img = _InputOutputArray(target);
+        _origin = label.origin - shift;
+        _offset = 0;
+        _pTextbox = textbox;
+        _buf.assign(label.text);
+        _nextLine();
+    }
+    const text_style style;
+    const fancy_style fancy;
+};
+
+void putTextBatch(InputOutputArray img, const fancy_label* labels, size_t count,
+    std::vector<Rect>* textboxes, label_cache* cache)
+{
+    _drawBatch<_fancyLabelStream>(img, labels, count, textboxes, cache);
+}
+
+void placeLabels(Size imgSize, const anchored_fancy_label* labels, size_t count, std::vector<fancy_label>& placed,
+    std::vector<int>* chosen, const std::vector<label_placement>* placements, int pad)
 {
+    _placeBatch<_fancyLabelStream>(imgSize, labels, count, placed, chosen, placements, pad);
+}
+
+void putTextPlaced(InputOutputArray img, const anchored_fancy_label* labels, size_t count,
+    std::vector<int>* chosen, const std::vector<label_placement>* placements, int pad, label_cache* cache)
+{
+    std::vector<fancy_label> placed;
+    placeLabels(img.size(), labels, count, placed, chosen, placements, pad);
+    putTextBatch(img, placed, nullptr, cache);
 }
 
 #endif // CV2_PUTTEXT_FANCY_HPP_IMPL
 
 } // namespace cv
 
-/* TODO:
- * The two _nextLine() functions are almost identical.
- * . Make a drawLine(line, baseline, line_width, line_height, origin_adj)
- *   protected function, that _nextLine calls, then rm _nextLine from fancy.
- * . Tho this apparently requires either CRTP or virtuals...
- * The << operator template in class prevents definition of a << operator for
- *   lhs image_ostream and rhs image_ostream_fancy.
- * . The trivial solution escapes me
- */
-
 #endif // __CV2_PUTTEXT_FANCY_HPP__
 
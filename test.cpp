@@ -2,11 +2,73 @@
 
 #include "opencv2/opencv.hpp"
 
+// The tests run with the trace hooks compiled in, and Fancy_Trace checks them; but not with
+// CV2_PUTTEXT_NO_TRACE (the TSan build), as trace_buffer's lock would order the draws it races
+#ifndef CV2_PUTTEXT_NO_TRACE
+#define CV2_PUTTEXT_TRACE
+#endif
 #define CV2_PUTTEXT_HPP_IMPL
 #include "cv2_putText.hpp"
 #define CV2_PUTTEXT_FANCY_HPP_IMPL
 #include "cv2_putText_fancy.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <thread>
+
+// Counts heap allocations, for the tests of allocation-free paths. Every form of new and delete
+// is replaced, so none pairs with the library's own; the free stays out of line, or GCC, seeing
+// it inlined after a new, warns of mismatched families (-Wmismatched-new-delete)
+static std::atomic<size_t> g_allocations{0};
+static void* countedAlloc(std::size_t size, std::size_t align = 0) noexcept {
+  ++g_allocations;
+  size = size ? size : 1;
+  if(!align) return std::malloc(size);
+  return std::aligned_alloc(align, (size + align - 1)/align*align);
+}
+[[gnu::noinline]] static void countedFree(void* p) noexcept { std::free(p); }
+void* operator new(std::size_t size) {
+  if(void* p = countedAlloc(size)) return p;
+  throw std::bad_alloc();
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+  if(void* p = countedAlloc(size, static_cast<std::size_t>(align))) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t align) { return ::operator new(size, align); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlloc(size, static_cast<std::size_t>(align)); }
+void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return countedAlloc(size, static_cast<std::size_t>(align)); }
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { countedFree(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { countedFree(p); }
+
+// Each test's image, as written last; the golden harness compares it, and skips the writes
+// while timing
+static cv::Mat g_written;
+static bool g_timing = false;
+static void testWrite(const std::string& file, cv::InputArray img) {
+  img.copyTo(g_written);
+  if(!g_timing) cv::imwrite(file, img);
+}
+
 static inline cv::Point operator+(const cv::Point& lhs, const cv::Size& rhs) {
   return cv::Point(lhs.x + rhs.width, lhs.y + rhs.height);
 }
@@ -34,7 +96,7 @@ TEST(Normal, "puttext_normal") {
   cv::putText(img, cv::Point(40, 40))
     << BASIC_BLURB;
 
-  cv::imwrite(sNormal_FullFile, img);
+  testWrite(sNormal_FullFile, img);
 }
 
 TEST(NormalSetChains, "puttext_normal_setchains"){
@@ -48,7 +110,7 @@ TEST(NormalSetChains, "puttext_normal_setchains"){
     .color(fancy::Red)
     << BASIC_BLURB;
 
-  cv::imwrite(sNormalSetChains_FullFile, img);
+  testWrite(sNormalSetChains_FullFile, img);
 }
 
 TEST(NormalReuse, "puttext_normal_reuse") {
@@ -58,7 +120,7 @@ TEST(NormalReuse, "puttext_normal_reuse") {
     out
       << BASIC_BLURB;
   }
-  cv::imwrite(sNormalReuse_FullFile, img);
+  testWrite(sNormalReuse_FullFile, img);
 }
 
 TEST(NormalPositioning, "puttext_normal_positioning") {
@@ -80,7 +142,7 @@ TEST(NormalPositioning, "puttext_normal_positioning") {
   cv::putText(img, origin4,
       cv::Scalar::all(0), 2, 1.0, 1.1, cv::FONT_HERSHEY_SIMPLEX, cv::LINE_AA,
       true) << "Hg: cv2_putText, bottomLeftOrigin=true";
-  cv::imwrite(sNormalPositioning_FullFile, img);
+  testWrite(sNormalPositioning_FullFile, img);
 }
 
 TEST(NormalAlignment, "puttext_normal_alignment") {
@@ -96,7 +158,7 @@ TEST(NormalAlignment, "puttext_normal_alignment") {
   {auto fmt = cv::putText(img, cv::Point(width/2, 340));
     fmt._align_opt = cv::image_ostream::TextAlign::Right;
     fmt << "Align Right\n"; }
-  cv::imwrite(sNormalAlignment_FullFile, img);
+  testWrite(sNormalAlignment_FullFile, img);
 }
 
 TEST(NormalOnelineCenter, "puttext_normal_onelinecenter"){
@@ -119,7 +181,7 @@ TEST(NormalOnelineCenter, "puttext_normal_onelinecenter"){
         fmt << "Align Right"; }
   }
 
-  cv::imwrite(sNormalOnelineCenter_FullFile, img);
+  testWrite(sNormalOnelineCenter_FullFile, img);
 }
 
 TEST(Normal_RelativeTo, "puttext_normal_relativeto"){
@@ -154,7 +216,7 @@ TEST(Normal_RelativeTo, "puttext_normal_relativeto"){
   cv::putText_RelativeTo(img, rect, fancy::VertAlign::Mid, fancy::TextAlign::Left, true) << "LM-in";
   cv::putText_RelativeTo(img, rect, fancy::VertAlign::Mid, fancy::TextAlign::Right, true) << "RM-in";
 
-  cv::imwrite(sNormal_RelativeTo_FullFile, img);
+  testWrite(sNormal_RelativeTo_FullFile, img);
 }
 
 TEST(Normal_RelativeToMultiline, "puttext_normal_relativeto_multiline"){
@@ -203,7 +265,7 @@ TEST(Normal_RelativeToMultiline, "puttext_normal_relativeto_multiline"){
   cv::putText_RelativeTo(img, rect, fancy::TextAlign::Right, fancy::VertAlign::Top, false, true).setOriginResult(&origin).setTextboxResult(&bbox)    << "RT" << "\nbottomLeft\n_origin=True!"; box();
   cv::putText_RelativeTo(img, rect, fancy::TextAlign::Right, fancy::VertAlign::Bottom, false, true).setOriginResult(&origin).setTextboxResult(&bbox) << "RB" << "\nbottomLeft\n_origin=True!"; box();
 
-  cv::imwrite(sNormal_RelativeToMultiline_FullFile, img);
+  testWrite(sNormal_RelativeToMultiline_FullFile, img);
 }
 
 TEST(Normal_StackFmts, "puttext_normal_stackfmts"){
@@ -219,7 +281,7 @@ TEST(Normal_StackFmts, "puttext_normal_stackfmts"){
     << "Lastly, it's green, 4, scale 0.5,\n\t2x line space, duplex" << std::endl
     << BASIC_BLURB;
   }
-  cv::imwrite(sNormal_StackFmts_FullFile, img);
+  testWrite(sNormal_StackFmts_FullFile, img);
 }
 
 TEST(Normal_Demo, "puttext_normal_demo") {
@@ -241,7 +303,7 @@ TEST(Normal_Demo, "puttext_normal_demo") {
     << "std::scientific " << std::scientific << CV_PI << std::endl
     << "So you can use cv::putText like regular std::cout!"
   ;
-  cv::imwrite(sNormal_Demo_FullFile, img);
+  testWrite(sNormal_Demo_FullFile, img);
 }
 
 TEST(Normal_Sizes, "puttext_normal_sizes") {
@@ -266,7 +328,611 @@ TEST(Normal_Sizes, "puttext_normal_sizes") {
   }
   cv::rectangle(img, origin, origin + textSize, fancy::Black);
 
-  cv::imwrite(sNormal_Sizes_FullFile, img);
+  testWrite(sNormal_Sizes_FullFile, img);
+}
+
+TEST(Normal_MetricsCache, "puttext_normal_metricscache") {
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  auto& cache = cv::text_metrics_cache::global();
+  cache.clear();
+  cache.resetStats();
+
+  std::vector<cv::Size> lineSizes[2]{};
+  cv::Size textSize[2]{};
+  for(int i = 0; i < 2; ++i){
+    cv::putText(img, cv::Point(40, 40 + 200*i))
+        .setTextSizeResult(&textSize[i]).setLineSizesResult(&lineSizes[i])
+      << "Measured once,\nthen memoized";
+  }
+  // Short lines are summed from the font's advances every time, never looked up
+  auto stats = cache.stats();
+  CV_Assert(stats.direct == 4 && stats.misses == 0 && stats.hits == 0 && stats.entries == 0);
+  CV_Assert(textSize[0] == textSize[1] && lineSizes[0] == lineSizes[1]);
+
+  // Long ones are measured once, then memoized; the same answer as the uncached call
+  const std::string longLine(cv::text_metrics_cache::directLength, 'm');
+  int cachedBase[2], base;
+  cv::Size cached[2];
+  for(int i = 0; i < 2; ++i)
+    cached[i] = cache.getTextSize(longLine, cv::FONT_HERSHEY_SIMPLEX, 1.0, 2, &cachedBase[i]);
+  stats = cache.stats();
+  CV_Assert(stats.misses == 1 && stats.hits == 1 && stats.entries == 1);
+  CV_Assert(cached[0] == cv::getTextSize(longLine, cv::FONT_HERSHEY_SIMPLEX, 1.0, 2, &base) && cached[1] == cached[0]);
+  CV_Assert(cachedBase[0] == base && cachedBase[1] == base);
+
+  // One capacity for every thread's cache, existing or new, taken on its next use
+  cv::text_metrics_cache::setGlobalCapacity(0);
+  cv::putText(img, cv::Point(40, 440)) << "then memoized";
+  CV_Assert(cv::text_metrics_cache::global().stats().capacity == 0 && cache.stats().entries == 0);
+  cache.getTextSize(longLine, cv::FONT_HERSHEY_SIMPLEX, 1.0, 2, nullptr);
+  CV_Assert(cache.stats().misses == 2 && cache.stats().entries == 0);
+  std::thread([]{ CV_Assert(cv::text_metrics_cache::global().stats().capacity == 0); }).join();
+  cv::text_metrics_cache::setGlobalCapacity(1024);
+  CV_Assert(cv::text_metrics_cache::global().stats().capacity == 1024);
+
+  testWrite(sNormal_MetricsCache_FullFile, img);
+}
+
+TEST(Normal_TextBuffer, "puttext_normal_textbuffer") {
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  // The same lines as std::ostream makes, formatters and all
+  const auto fill = [](auto& out) -> auto& {
+    return out << BASIC_BLURB << std::endl
+      << std::setw(8) << std::setfill('.') << "setw" << std::left << std::setw(6) << 42 << '|' << std::endl
+      << std::string(200, 'w').substr(0, 150) << "\tspilled past the inline buffer";
+  };
+  std::ostringstream expected;
+  fill(expected);
+  std::vector<cv::Size> lineSizes;
+  fill(cv::putText(img, cv::Point(40, 40), fancy::Black, 1, 0.6).setLineSizesResult(&lineSizes));
+  std::istringstream lines(expected.str());
+  std::string line;
+  size_t i = 0;
+  for(; std::getline(lines, line); ++i){
+    size_t tab;
+    while((tab = line.find('\t')) != std::string::npos) line.replace(tab, 1, "  ");
+    int base;
+    CV_Assert(i < lineSizes.size());
+    CV_Assert(lineSizes[i].width == (line.empty() ? 0 : cv::getTextSize(line, cv::FONT_HERSHEY_SIMPLEX, 0.6, 1, &base).width));
+  }
+  CV_Assert(i == lineSizes.size());
+
+  // Building and measuring a short label allocates nothing
+  cv::Size size[2];
+  const auto label = [&](cv::Size* result){
+    cv::putText(cv::noArray(), cv::Point(0, 0)).setTextSizeResult(result)
+      << "car #" << 7 << ' ' << std::setprecision(2) << 0.93 << std::endl << "lane " << 2 << cv::putText();
+  };
+  label(&size[0]);
+  const size_t before = g_allocations;
+  for(int k = 0; k < 100; ++k) label(&size[1]);
+  CV_Assert(g_allocations == before);
+  CV_Assert(size[0] == size[1] && size[0].width > 0);
+
+  testWrite(sNormal_TextBuffer_FullFile, img);
+}
+
+TEST(Normal_Numbers, "puttext_normal_numbers") {
+  // Numbers are formatted with std::to_chars(), unless the stream's settings need it; either
+  // way, the text is what std::ostream writes
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  const auto text = [](const auto& format){
+    std::ostringstream expected;
+    format(expected);
+    auto out = cv::putText(cv::noArray(), cv::Point(0, 0));
+    format(out);
+    const cv::text_layout layout = out.layout();
+    CV_Assert(layout.lines.size() == 1 && layout.lines[0].text == expected.str());
+    return expected.str();
+  };
+  const double doubles[] = {0.0, -0.0, 1.0, -2.5, 0.1, 3.14159265358979, 1e-300, 1e300, 123456789.125,
+    1e21, 5e-324, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+    std::numeric_limits<double>::quiet_NaN()};
+  for(const double d : doubles){
+    const float f = (float)d;
+    const long double ld = d;
+    text([&](auto& o){ o << d << ' ' << f << ' ' << ld; });
+    for(const int precision : {-1, 0, 1, 3, 6, 10, 17, 40}){
+      text([&](auto& o){ o << std::setprecision(precision) << d << ' ' << f; });
+      text([&](auto& o){ o << std::fixed << std::setprecision(precision) << d << ' ' << f; });
+      text([&](auto& o){ o << std::scientific << std::setprecision(precision) << d << ' ' << ld; });
+    }
+    // Left to the stream
+    text([&](auto& o){ o << std::showpos << d << std::showpoint << ' ' << f; });
+    text([&](auto& o){ o << std::hexfloat << d << ' ' << std::uppercase << std::scientific << f; });
+    text([&](auto& o){ o << std::setw(12) << std::left << d << '|' << std::setfill('*') << std::setw(9) << f; });
+  }
+  for(const long long i : {0LL, 7LL, -42LL, 1000000LL, (long long)INT_MIN, LLONG_MIN, LLONG_MAX}){
+    text([&](auto& o){ o << (int)i << ' ' << i << ' ' << (unsigned long)i << ' ' << (short)i; });
+    text([&](auto& o){ o << std::hex << (int)i << ' ' << std::showbase << std::oct << i << std::dec << ' ' << i; });
+    text([&](auto& o){ o << std::showpos << i << std::noshowpos << std::setw(8) << (int)i << ' ' << i; });
+  }
+  // Characters and bools are still written as characters and 0/1 (or true/false)
+  CV_Assert(text([](auto& o){ o << 'x' << (signed char)'y' << (unsigned char)'z' << true
+      << std::boolalpha << false; }) == "xyz1false");
+
+  // No allocations, with or without manipulators, once the line's size is memoized
+  const auto readout = [](){
+    cv::putText(cv::noArray(), cv::Point(0, 0)) << "x " << 1.5 << ' ' << 42 << ' '
+      << std::fixed << std::setprecision(2) << 0.1 << cv::putText();
+  };
+  readout();
+  const size_t before = g_allocations;
+  for(int k = 0; k < 100; ++k) readout();
+  CV_Assert(g_allocations == before);
+
+  int y = 40;
+  for(const auto& line : {text([](auto& o){ o << 3.14159265 << ' ' << -42 << ' ' << 1e300; }),
+      text([](auto& o){ o << std::fixed << std::setprecision(3) << 2.0/3 << ' ' << 1e-5f; })}){
+    cv::putText(img, cv::Point(20, y)) << line;
+    y += 50;
+  }
+  testWrite(sNormal_Numbers_FullFile, img);
+}
+
+TEST(Normal_Layout, "puttext_normal_layout") {
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  cv::Mat fromLayout = img.clone();
+  const auto stream = [](cv::InputOutputArray out, cv::Point at, cv::image_ostream::TextAlign align, bool reverse){
+    return cv::putText(out, at, fancy::Black, 1, 0.8).align(align).reverse(reverse).bottomLeftOrigin(reverse);
+  };
+  using TA = cv::image_ostream::TextAlign;
+  int k = 0;
+  for(const auto& text : {"Laid out\n\tthen drawn\n", "One centered line", "Stacked\nup\nfrom the origin"}){
+    const cv::Point at(400, 60 + 150*k);
+    const TA align = k == 0 ? TA::Left : k == 1 ? TA::Center : TA::Right;
+    const bool reverse = k == 2;
+    ++k;
+
+    // Laying out draws nothing, and leaves the text to draw
+    cv::Size textSize;
+    cv::Rect textbox;
+    cv::Point origin;
+    std::vector<cv::Size> lineSizes;
+    cv::text_layout layout;
+    {
+      auto&& out = stream(img, at, align, reverse);
+      out.setTextSizeResult(&textSize).setTextboxResult(&textbox).setOriginResult(&origin)
+        .setLineSizesResult(&lineSizes) << text;
+      layout = out.layout();
+      CV_Assert(cv::norm(img, fromLayout, cv::NORM_INF) == 0);
+    }
+    CV_Assert(layout.textSize == textSize && layout.textbox == textbox && layout.origin == origin);
+    CV_Assert(layout.lineSizes() == lineSizes);
+
+    // The same pixels, drawn from the layout
+    if(cv::image_ostream::_Debug.draw_origin) cv::drawMarker(fromLayout, at, cv::Scalar(0, 0, 255));
+    for(const auto& line : layout.lines)
+      if(!line.text.empty())
+        cv::putText(fromLayout, line.text, line.org, cv::FONT_HERSHEY_SIMPLEX, 0.8, fancy::Black, 1);
+    CV_Assert(cv::norm(img, fromLayout, cv::NORM_INF) == 0);
+  }
+
+  // Fancy streams lay out at their outline's thickness
+  cv::Size fancySize;
+  cv::text_layout fancyLayout;
+  {
+    auto out = cv::putTextOutline(img, cv::Point(40, 380), fancy::White, 1, 1.0, 1.1, fancy::Black, 4);
+    out.setTextSizeResult(&fancySize) << "outlined\ntext";
+    fancyLayout = out.layout();
+  }
+  CV_Assert(fancyLayout.textSize == fancySize && fancyLayout.lines.size() == 2);
+
+  testWrite(sNormal_Layout_FullFile, img);
+}
+
+TEST(Normal_Placement, "puttext_normal_placement") {
+  // Crowded detections, some at the image border, each labelled around its box
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  std::vector<cv::anchored_label> labels;
+  for(int i = 0; i < 80; ++i){
+    const cv::Rect anchor(-20 + (71*i) % 780, -15 + (43*i) % 490, 40 + (i % 5)*12, 30 + (i % 3)*20);
+    labels.push_back({anchor, {cv::Point(), (i % 4 ? "det " : "jpg ") + std::to_string(i) + (i % 6 ? "" : "\n0.9"), {}}, {}});
+  }
+  labels[3].placements = {{cv::image_ostream::VertAlign::Bottom, cv::image_ostream::TextAlign::Right, false}};
+  labels.push_back({cv::Rect(10, 10, 10, 10), {cv::Point(), "", {}}, {}});
+  for(const auto& l : labels)
+    cv::rectangle(img, l.anchor, fancy::Grey);
+  cv::Mat chained = img.clone();
+
+  std::vector<int> chosen;
+  std::vector<cv::text_label> placed;
+  cv::placeLabels(img.size(), labels.data(), labels.size(), placed, &chosen);
+  CV_Assert(chosen.size() == labels.size() && chosen.back() == -1);
+  CV_Assert(placed.size() == size_t(std::count_if(chosen.begin(), chosen.end(), [](int k){ return k >= 0; })));
+  CV_Assert(chosen[3] <= 0);
+
+  // Placed labels lie inside the image, clear of each other
+  std::vector<cv::Rect> boxes;
+  cv::putTextBatch(img, placed, &boxes);
+  const cv::Rect image(cv::Point(0, 0), img.size());
+  for(size_t i = 0; i < boxes.size(); ++i){
+    CV_Assert((boxes[i] & image) == boxes[i]);
+    for(size_t j = 0; j < i; ++j)
+      CV_Assert((boxes[i] & boxes[j]).empty());
+  }
+  CV_Assert(placed.size() > labels.size()/3);
+
+  // Nor does their ink touch: each label on its own mask, none sharing a pixel
+  const auto inkApart = [&img](auto placed){
+    cv::Mat all(img.size(), CV_8UC1, cv::Scalar::all(0)), mine = all.clone(), both;
+    for(auto& l : placed){
+      l.style.color = cv::Scalar::all(255);
+      if constexpr(std::is_same_v<std::decay_t<decltype(l)>, cv::fancy_label>){
+        if(l.fancy && l.fancy->outlineColor) l.fancy->outlineColor = cv::Scalar::all(255);
+        if(l.fancy && l.fancy->bgColor) l.fancy->bgColor = cv::Scalar::all(255);
+      }
+      mine.setTo(cv::Scalar::all(0));
+      cv::putTextBatch(mine, &l, 1);
+      cv::bitwise_and(all, mine, both);
+      CV_Assert(cv::countNonZero(both) == 0);
+      cv::bitwise_or(all, mine, all);
+    }
+  };
+  inkApart(placed);
+
+  // The same pixels as putText_RelativeTo() with each chosen placement
+  const std::vector<cv::label_placement> around{
+    {cv::image_ostream::VertAlign::Top, cv::image_ostream::TextAlign::Left, false},
+    {cv::image_ostream::VertAlign::Top, cv::image_ostream::TextAlign::Right, false},
+    {cv::image_ostream::VertAlign::Bottom, cv::image_ostream::TextAlign::Left, false},
+    {cv::image_ostream::VertAlign::Bottom, cv::image_ostream::TextAlign::Right, false},
+    {cv::image_ostream::VertAlign::Top, cv::image_ostream::TextAlign::Left, true}};
+  for(size_t i = 0; i < labels.size(); ++i){
+    if(chosen[i] < 0) continue;
+    const auto& p = labels[i].placements.empty() ? around[chosen[i]] : labels[i].placements[chosen[i]];
+    cv::putText_RelativeTo(chained, labels[i].anchor, p.vert, p.horz, p.inside) << labels[i].label.text;
+  }
+  CV_Assert(cv::norm(img, chained, cv::NORM_INF) == 0);
+
+  // Fancy labels keep clear of each other's background too
+  std::vector<cv::anchored_fancy_label> fancyLabels;
+  cv::fancy_style bg;
+  bg.bgColor = fancy::Green;
+  for(const auto& l : labels)
+    fancyLabels.push_back({l.anchor, {l.label.origin, l.label.text, l.label.style, bg}, l.placements});
+  std::vector<int> fancyChosen;
+  cv::putTextPlaced(img, fancyLabels, &fancyChosen);
+  CV_Assert(fancyChosen.size() == labels.size());
+  std::vector<cv::fancy_label> fancyPlaced;
+  cv::placeLabels(img.size(), fancyLabels.data(), fancyLabels.size(), fancyPlaced);
+  inkApart(fancyPlaced);
+
+  testWrite(sNormal_Placement_FullFile, img);
+}
+
+TEST(Normal_Culling, "puttext_normal_culling") {
+  // A scrolled log, mostly above and below the image, and labels past each edge of an ROI
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  cv::Mat reference = img.clone();
+  const cv::Rect roi(100, 50, 600, 400);
+  cv::rectangle(img, roi, fancy::Grey);
+  cv::rectangle(reference, roi, fancy::Grey);
+  const auto stream = [](cv::InputOutputArray out, cv::Point at, int k){
+    return cv::putText(out, at, fancy::Black, 1 + k % 3, 0.5 + 0.25*(k % 4), 1.1, cv::FONT_HERSHEY_SIMPLEX,
+        k % 2 ? cv::LINE_AA : cv::LINE_8).backend(k % 5 ? cv::image_ostream::Backend::Stroke : cv::image_ostream::Backend::Atlas);
+  };
+  std::ostringstream log;
+  for(int i = 0; i < 200; ++i)
+    log << "log line " << i << ": " << std::string(i % 40, '=') << "|\n";
+  const std::pair<cv::Point, std::string> texts[] = {
+    {cv::Point(20, -900), log.str()},
+    {cv::Point(-300, 100), "off the left edge"},
+    {cv::Point(500, 200), "a line running well past the right edge of the image"},
+    {cv::Point(590, 300), "just\ncrossing the right edge"},
+    {cv::Point(700, 20), "right of it all"},
+    {cv::Point(200, 420), "below\nthe bottom"}};
+
+  int k = 0;
+  for(cv::Mat canvas : {img, cv::Mat(img, roi)}){
+    cv::Mat ref = canvas.data == img.data ? reference : cv::Mat(reference, roi);
+    for(const auto& t : texts){
+      // Culled lines still count in the results
+      cv::Size drawn, measured;
+      cv::text_layout layout;
+      {
+        auto&& out = stream(canvas, t.first, k);
+        out.setTextSizeResult(&drawn) << t.second;
+        layout = out.layout();
+      }
+      stream(cv::noArray(), t.first, k).setTextSizeResult(&measured) << t.second << cv::putText();
+      CV_Assert(drawn == measured && drawn == layout.textSize);
+
+      if(cv::image_ostream::_Debug.draw_origin) cv::drawMarker(ref, t.first, cv::Scalar(0, 0, 255));
+      for(const auto& line : layout.lines)
+        if(!line.text.empty())
+          cv::putText(ref, line.text, line.org, cv::FONT_HERSHEY_SIMPLEX, 0.5 + 0.25*(k % 4), fancy::Black,
+              1 + k % 3, k % 2 ? cv::LINE_AA : cv::LINE_8);
+      ++k;
+    }
+  }
+  CV_Assert(cv::norm(img, reference, cv::NORM_INF) == 0);
+
+  testWrite(sNormal_Culling_FullFile, img);
+}
+
+TEST(Normal_Hud, "puttext_normal_hud") {
+  // A dashboard: a few fields over a panel, most of them unchanged from frame to frame
+  cv::Mat panel(500, 800, CV_8UC3, fancy::White);
+  for(int y = 0; y < panel.rows; y += 40)
+    panel.rowRange(y, y + 20).setTo(fancy::Grey);
+  cv::text_style small, big;
+  small.fontScale = 0.6;
+  small.lineType = cv::LINE_AA;
+  big.color = fancy::Red;
+  big.thickness = 3;
+  big.fontScale = 1.5;
+  const auto setup = [&](cv::text_hud& hud){
+    hud.slot("fps", cv::Point(20, 20), small);
+    hud.slot("time", [](const std::string& text, cv::display_list& list){
+      cv::putTextOutline(cv::noArray(), cv::Point(780, 20), fancy::White, 2, 0.8).align(fancy::TA::Right)
+        .displayList(&list) << text;
+    });
+    hud.slot("count", cv::Point(20, 200), big);
+    hud.slot("status", cv::Point(60, 215), small); // under count's text
+  };
+  // Drawn from scratch, the same fields give the same pixels
+  const auto fresh = [&](const std::map<std::string, std::string>& fields){
+    cv::text_hud hud(panel);
+    setup(hud);
+    for(const auto& f : fields) hud.set(f.first, f.second);
+    hud.render();
+    return hud.image().clone();
+  };
+
+  cv::text_hud hud(panel);
+  setup(hud);
+  std::map<std::string, std::string> fields{
+    {"fps", "FPS: 30"}, {"time", "12:00:00"}, {"count", "cars: 7"}, {"status", "ok"}};
+  for(const auto& f : fields) hud.set(f.first, f.second);
+  cv::text_hud::Stats counts = hud.render();
+  CV_Assert(counts.changed == 4 && counts.skipped == 0);
+  CV_Assert(cv::norm(hud.image(), fresh(fields), cv::NORM_INF) == 0);
+
+  // One field changes: it alone is drawn again, and only its area changes
+  cv::Mat before = hud.image().clone();
+  cv::damage_region damage;
+  fields["fps"] = "FPS: 29";
+  hud.set("fps", fields["fps"]);
+  hud.set("time", fields["time"]);
+  counts = hud.render(&damage);
+  CV_Assert(counts.changed == 1 && counts.redrawn == 0 && counts.skipped == 3);
+  CV_Assert(cv::norm(hud.image(), fresh(fields), cv::NORM_INF) == 0);
+  for(const cv::Rect& r : damage.rects()) hud.image()(r).copyTo(before(r));
+  CV_Assert(cv::norm(hud.image(), before, cv::NORM_INF) == 0);
+
+  // Overlapping fields are drawn again with it, in order; unchanged text costs nothing
+  fields["count"] = "cars: 12";
+  hud.set("count", fields["count"]);
+  counts = hud.render();
+  CV_Assert(counts.changed == 1 && counts.redrawn == 1 && counts.skipped == 2);
+  CV_Assert(cv::norm(hud.image(), fresh(fields), cv::NORM_INF) == 0);
+  counts = hud.render();
+  CV_Assert(counts.changed == 0 && counts.skipped == 4);
+
+  // Erased and restyled slots
+  hud.erase("status");
+  fields.erase("status");
+  hud.render();
+  CV_Assert(cv::norm(hud.image(), fresh(fields), cv::NORM_INF) == 0);
+  const cv::text_hud::Stats totals = hud.stats();
+  CV_Assert(totals.renders == 5 && totals.changed == 6);
+
+  testWrite(sNormal_Hud_FullFile, hud.image());
+}
+
+TEST(Normal_GlyphMetrics, "puttext_normal_glyphmetrics") {
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  const std::string texts[] = {
+    "", " ", "Hg", "The quick brown fox jumps over the lazy dog 0123456789",
+    "~!@#$%^&*()_+`-={}|[]\\:\";'<>?,./", "ctrl\x01\x1f\x7f bytes", "\xd0\x9f\xd1\x80\xd0\xb8 \xc3\xa9\xe2\x82\xac",
+  };
+  int y = 30;
+  for(int face = cv::FONT_HERSHEY_SIMPLEX; face <= cv::FONT_HERSHEY_SCRIPT_COMPLEX; ++face){
+    for(const int italic : {0, (int)cv::FONT_ITALIC}){
+      const cv::hershey_metrics* glyphs = cv::hershey_metrics::get(face | italic);
+      CV_Assert(glyphs != nullptr);
+      for(const double scale : {0.3, 0.5, 0.7, 1.0, 1.3, 2.0, 3.7}){
+        for(const int thickness : {1, 2, 4, 7}){
+          for(const std::string& text : texts){
+            int base, glyphsBase;
+            const cv::Size size = cv::getTextSize(text, face | italic, scale, thickness, &base);
+            CV_Assert(glyphs->getTextSize(text, scale, thickness, &glyphsBase) == size);
+            CV_Assert(glyphsBase == base);
+          }
+        }
+      }
+    }
+    cv::putText(img, cv::Point(20, y), fancy::Black, 1, 0.8, 1.1, (cv::HersheyFonts)face)
+      << texts[3];
+    y += 50;
+  }
+  CV_Assert(cv::hershey_metrics::get(cv::FONT_HERSHEY_SCRIPT_COMPLEX + 1) == nullptr);
+  testWrite(sNormal_GlyphMetrics_FullFile, img);
+}
+
+TEST(Normal_Atlas, "puttext_normal_atlas") {
+  using Backend = cv::image_ostream::Backend;
+  cv::Mat stroked(900, 800, CV_8UC3, fancy::White);
+  cv::Mat atlased = stroked.clone();
+  const auto draw = [](cv::Mat& img, Backend backend){
+    int y = 20;
+    for(const double scale : {0.5, 0.7, 1.0, 1.3}){
+      for(const int thickness : {1, 2, 4}){
+        for(const cv::LineTypes lineType : {cv::LINE_4, cv::LINE_8}){
+          const auto face = (cv::HersheyFonts)((y / 20) % 8);
+          cv::putText(img, cv::Point(10 + y % 7, y), fancy::Black, thickness, scale, 1.1, face, lineType)
+              .backend(backend)
+            << "Glyph atlas: The quick brown fox, 0123456789 {}[]|";
+          y += 18;
+        }
+      }
+    }
+    // Runs off the right edge; falls back to cv::putText
+    cv::putText(img, cv::Point(600, y + 20)).backend(backend) << "Clipped at the border";
+    cv::putTextOutline(img, cv::Point(20, y + 60), fancy::White, 2, 1.0, 1.1, fancy::Red)
+        .backend(backend)
+      << "Outlines too\nmulti-line";
+  };
+  // Compare the atlas' own pixels, then again under Debug::verify_backend
+  const bool verify = cv::image_ostream::_Debug.verify_backend;
+  cv::image_ostream::_Debug.verify_backend = false;
+  draw(stroked, Backend::Stroke);
+  draw(atlased, Backend::Atlas);
+  CV_Assert(cv::norm(stroked, atlased, cv::NORM_INF) == 0);
+
+  // Second pass is served from the atlas
+  cv::image_ostream::_Debug.verify_backend = true;
+  const auto before = cv::glyph_atlas::globalStats();
+  draw(atlased, Backend::Atlas);
+  const auto after = cv::glyph_atlas::globalStats();
+  CV_Assert(after.misses == before.misses && after.hits > before.hits);
+  CV_Assert(after.fallbacks > before.fallbacks && after.mismatches == 0);
+  cv::image_ostream::_Debug.verify_backend = verify;
+
+  // Blanks have no ink, and are no reason to fall back
+  for(const cv::LineTypes lineType : {cv::LINE_4, cv::LINE_8}){
+    const auto spaced = cv::glyph_atlas::globalStats();
+    cv::putText(atlased, cv::Point(400, 870), fancy::Blue, 1, 0.7, 1.1, cv::FONT_HERSHEY_SIMPLEX, lineType)
+        .backend(Backend::Atlas)
+      << "  words  apart  ";
+    CV_Assert(cv::glyph_atlas::globalStats().fallbacks == spaced.fallbacks);
+  }
+
+  // Past the byte budget, the least recently used atlases are emptied, whole
+  const size_t budget = cv::glyph_atlas::globalByteBudget();
+  cv::glyph_atlas::clearAll();
+  cv::glyph_atlas::setGlobalByteBudget(256 << 10);
+  const auto unbudgeted = cv::glyph_atlas::globalStats();
+  cv::Mat scratch(100, 1200, CV_8UC3, fancy::White);
+  const auto drawAt = [&scratch](double scale){
+    cv::putText(scratch, cv::Point(10, 60), fancy::Black, 2, scale).backend(Backend::Atlas)
+      << "Glyph atlas: The quick brown fox, 0123456789 {}[]|";
+  };
+  for(const double scale : {0.5, 0.6, 0.7, 0.8, 0.9, 1.0, 1.1, 1.2}) drawAt(scale);
+  const auto filled = cv::glyph_atlas::globalStats();
+  drawAt(1.2); // all from its atlas, the most recently used, once the others are emptied
+  const auto budgeted = cv::glyph_atlas::globalStats();
+  CV_Assert(budgeted.evictions > unbudgeted.evictions && budgeted.bytes <= (256 << 10));
+  CV_Assert(budgeted.misses == filled.misses);
+  cv::glyph_atlas::setGlobalByteBudget(budget);
+
+  testWrite(sNormal_Atlas_FullFile, atlased);
+}
+
+TEST(Normal_MaskBlend, "puttext_normal_maskblend") {
+  // Every coverage value, and empty runs, over pseudo-random pixels; odd ROI widths for the tails
+  cv::Mat mask(64, 131, CV_8UC1);
+  for(int y = 0; y < mask.rows; ++y)
+    for(int x = 0; x < mask.cols; ++x)
+      mask.at<uchar>(y, x) = (uchar)(x < 3 ? 255*(x % 2) : (x >= 40 && x < 80) ? 0 : (x*7 + y*13) % 256);
+  const cv::Scalar color(17, 200, 96, 255);
+  cv::Mat result;
+  for(const int type : {CV_8UC1, CV_8UC3, CV_8UC4}){
+    cv::Mat img(mask.rows + 2, mask.cols + 5, type);
+    uint32_t s = 12345;
+    for(int y = 0; y < img.rows; ++y)
+      for(int x = 0; x < img.cols*img.channels(); ++x)
+        img.ptr(y)[x] = (uchar)((s = s*1103515245u + 12345u) >> 24);
+    for(const int width : {mask.cols, 1, 15, 16, 17, 33, 100}){
+      const cv::Rect roi(3, 1, width, mask.rows);
+      cv::Mat vec = img.clone(), ref = img.clone();
+      cv::mask_blend::blend(vec(roi), mask(cv::Rect(0, 0, width, mask.rows)), color);
+      cv::mask_blend::blendScalar(ref(roi), mask(cv::Rect(0, 0, width, mask.rows)), color);
+      CV_Assert(cv::norm(vec, ref, cv::NORM_INF) == 0);
+      // Outside the ROI is untouched, 0 keeps the pixel and 255 writes the color
+      CV_Assert(cv::norm(vec.row(0), img.row(0), cv::NORM_INF) == 0);
+      for(int k = 0; k < img.channels(); ++k){
+        CV_Assert(vec.ptr(1)[(3 + 0)*img.channels() + k] == img.ptr(1)[(3 + 0)*img.channels() + k]);
+        CV_Assert(width == 1 || vec.ptr(1)[(3 + 1)*img.channels() + k] == (uchar)color[k]);
+      }
+      if(type == CV_8UC3) result = vec;
+    }
+  }
+  testWrite(sNormal_MaskBlend_FullFile, result);
+}
+
+TEST(Normal_Batch, "puttext_normal_batch") {
+  // Detections in a few interleaved styles, overlapping, some multi-line
+  cv::text_style styles[3];
+  styles[0].backend = cv::image_ostream::Backend::Atlas;
+  styles[1].color = fancy::Red;
+  styles[1].fontScale = 0.6;
+  styles[1].align = cv::image_ostream::TextAlign::Center;
+  styles[2].color = fancy::Blue;
+  styles[2].thickness = 1;
+  styles[2].lineType = cv::LINE_AA;
+  styles[2].bottomLeftOrigin = true;
+  styles[2].reverse = true;
+  std::vector<cv::text_label> labels;
+  for(int i = 0; i < 60; ++i)
+    labels.push_back({cv::Point(20 + (67*i) % 700, 30 + (37*i) % 440),
+        "det " + std::to_string(i) + (i % 4 ? "" : "\n0.9"), styles[i % 3]});
+  labels.push_back({cv::Point(10, 10), "", styles[0]});
+
+  cv::Mat chained(500, 800, CV_8UC3, fancy::White);
+  cv::Mat batched = chained.clone();
+  std::vector<cv::Rect> boxes;
+  for(const auto& l : labels){
+    const cv::text_style& s = l.style;
+    cv::Rect box;
+    cv::putText(chained, l.origin, s.color, s.thickness, s.fontScale, s.lineSpacing, s.fontFace,
+        s.lineType, s.bottomLeftOrigin, s.align, s.reverse, s.backend).setTextboxResult(&box)
+      << l.text;
+    boxes.push_back(box);
+  }
+  std::vector<cv::Rect> batchedBoxes;
+  cv::putTextBatch(batched, labels, &batchedBoxes);
+  CV_Assert(cv::norm(chained, batched, cv::NORM_INF) == 0 && boxes == batchedBoxes);
+
+  // Enough labels to draw in parallel bands; many cross band edges, or the image border
+  const int threads = cv::getNumThreads();
+  cv::setNumThreads(4);
+  for(int i = 0; i < 240; ++i)
+    labels.push_back({cv::Point(-30 + (53*i) % 820, -10 + (29*i) % 520),
+        "track " + std::to_string(i) + (i % 5 ? "" : "\nlost"), styles[i % 3]});
+  chained.setTo(fancy::White);
+  boxes.clear();
+  for(const auto& l : labels){
+    const cv::text_style& s = l.style;
+    cv::Rect box;
+    cv::putText(chained, l.origin, s.color, s.thickness, s.fontScale, s.lineSpacing, s.fontFace,
+        s.lineType, s.bottomLeftOrigin, s.align, s.reverse, s.backend).setTextboxResult(&box)
+      << l.text;
+    boxes.push_back(box);
+  }
+  batched.setTo(fancy::White);
+  cv::putTextBatch(batched, labels, &batchedBoxes);
+  CV_Assert(cv::norm(chained, batched, cv::NORM_INF) == 0 && boxes == batchedBoxes);
+  cv::setNumThreads(threads);
+
+  testWrite(sNormal_Batch_FullFile, batched);
+}
+
+TEST(Normal_BatchBands, "puttext_normal_batch_bands") {
+  // Big text from its bottom left, descenders and all, on every row around the band edges
+  cv::text_style style;
+  style.fontScale = 2.0;
+  style.thickness = 2;
+  style.bottomLeftOrigin = true;
+  cv::text_style script = style;
+  script.fontFace = cv::FONT_HERSHEY_SCRIPT_SIMPLEX;
+  script.lineType = cv::LINE_AA;
+  std::vector<cv::text_label> labels;
+  for(int i = 0; i < 160; ++i)
+    labels.push_back({cv::Point(-40 + (97*i) % 820, 95 + (i % 80)), i % 7 ? "jgpqy" : "Ajgy\nqp", i % 2 ? style : script});
+
+  const int threads = cv::getNumThreads();
+  cv::Mat serial(500, 800, CV_8UC3, fancy::White);
+  cv::Mat banded = serial.clone();
+  cv::setNumThreads(1);
+  cv::putTextBatch(serial, labels);
+  cv::setNumThreads(4);
+  cv::putTextBatch(banded, labels);
+  cv::setNumThreads(threads);
+  CV_Assert(cv::norm(serial, banded, cv::NORM_INF) == 0);
+
+  testWrite(sNormal_BatchBands_FullFile, banded);
 }
 
 // FIXME: this is broken, both with and without the && ref on fmt_base
@@ -280,7 +946,7 @@ TEST(Normal_Refs, "puttext_normal_refs") {
       << "\nGreen!\n(Called from reference)\n";
     fmt_res << "\nNo Overwrite! (From base)\n";
   }
-  cv::imwrite(sNormal_Refs_FullFile, img);
+  testWrite(sNormal_Refs_FullFile, img);
 }
 
 TEST(Fancy_Normal, "puttextfancy_normal") {
@@ -289,7 +955,7 @@ TEST(Fancy_Normal, "puttextfancy_normal") {
   cv::putTextFancy(img, cv::Point(40, 40), std::nullopt, 0, false, std::nullopt, false, false,
       fancy::Black, 1, 1.0, 1.2)
     << BASIC_BLURB;
-  cv::imwrite(sFancy_Normal_FullFile, img);
+  testWrite(sFancy_Normal_FullFile, img);
 }
 
 TEST(Fancy_SetChains, "puttextfancy_setchains"){
@@ -305,7 +971,7 @@ TEST(Fancy_SetChains, "puttextfancy_setchains"){
     .bgFilled(false)
     << BASIC_BLURB;
 
-  cv::imwrite(sFancy_SetChains_FullFile, img);
+  testWrite(sFancy_SetChains_FullFile, img);
 }
 
 TEST(Fancy_Stack, "puttextfancy_stack") {
@@ -321,7 +987,7 @@ TEST(Fancy_Stack, "puttextfancy_stack") {
   << cv::putTextFancy(std::nullopt, 0, false, std::nullopt, false, false, fancy::Shadow, 1, 0.5, 2.0, cv::FONT_HERSHEY_DUPLEX)
     << "Lastly, it's shadow, 1, scale 0.5,\n\t2x line space, duplex" << std::endl
     << BASIC_BLURB;
-  cv::imwrite(sFancy_Stack_FullFile, img);
+  testWrite(sFancy_Stack_FullFile, img);
 }
 
 TEST(Fancy_Outline, "puttextfancy_outline") {
@@ -373,7 +1039,7 @@ TEST(Fancy_Outline, "puttextfancy_outline") {
   << cv::putTextOutline(fancy::Blue, 4, 0.5, 1.0, fancy::Black, 2)
     << "Scale 0.5, Thickness 4, Outline 2" << std::endl
   ;
-  cv::imwrite(sFancy_Outline_FullFile, img);
+  testWrite(sFancy_Outline_FullFile, img);
 }
 
 TEST(Fancy_Shadow, "puttextfancy_shadow") {
@@ -388,7 +1054,509 @@ TEST(Fancy_Shadow, "puttextfancy_shadow") {
   << cv::putTextShadow(fancy::Blue, 3, 1.3)
     << "putTextShadow(kBlue, 3, 1.3)" << std::endl
   ;
-  cv::imwrite(sFancy_Shadow_FullFile, img);
+  testWrite(sFancy_Shadow_FullFile, img);
+}
+
+TEST(Fancy_Atlas, "puttextfancy_atlas") {
+  using Backend = cv::image_ostream::Backend;
+  cv::Mat stroked(600, 900, CV_8UC3, fancy::Grey);
+  cv::Mat atlased = stroked.clone();
+  const auto draw = [](cv::Mat& img, Backend backend){
+    // Outline and text composited in one pass
+    cv::putTextOutline(img, cv::Point(30, 20), fancy::White, 1, 1.0, 1.0, fancy::Black, 1)
+        .backend(backend)
+      << "Scale 1.0, Thickness 1, Outline 1" << std::endl
+    << cv::putTextOutline(fancy::Red, 2, 2.0, 1.0, fancy::Black, 4)
+      << "Scale 2.0, Thickness 2, Outline 4" << std::endl
+    << cv::putTextOutline(fancy::Blue, 4, 0.5, 1.0, fancy::Green, 2)
+      << "Scale 0.5, Thickness 4, Outline 2" << std::endl
+    // Shadows share the text's atlas
+    << cv::putTextShadow()
+      << "putTextShadow() for shadowed text" << std::endl
+    << cv::putTextShadow(fancy::Blue, 3, 1.3)
+      << "putTextShadow(kBlue, 3, 1.3)" << std::endl;
+    // Outline runs off the bottom; both layers fall back to cv::putText
+    cv::putTextOutline(img, cv::Point(30, 585)).backend(backend) << "Clipped outline";
+  };
+  const bool verify = cv::image_ostream::_Debug.verify_backend;
+  cv::image_ostream::_Debug.verify_backend = false;
+  draw(stroked, Backend::Stroke);
+  draw(atlased, Backend::Atlas);
+  CV_Assert(cv::norm(stroked, atlased, cv::NORM_INF) == 0);
+
+  cv::image_ostream::_Debug.verify_backend = true;
+  const auto before = cv::glyph_atlas::globalStats();
+  draw(atlased, Backend::Atlas);
+  const auto after = cv::glyph_atlas::globalStats();
+  CV_Assert(after.misses == before.misses && after.hits > before.hits);
+  CV_Assert(after.fallbacks > before.fallbacks && after.mismatches == 0);
+  cv::image_ostream::_Debug.verify_backend = verify;
+
+  // Spaces in either layer keep the single pass: blanks are valid glyphs, with no mask
+  const auto spaced = cv::glyph_atlas::globalStats();
+  cv::putTextOutline(atlased, cv::Point(500, 540), fancy::White, 1, 0.8, 1.0, fancy::Black, 2)
+      .backend(Backend::Atlas)
+    << " outlined  words " << std::endl
+  << cv::putTextShadow()
+    << " shadowed  words ";
+  CV_Assert(cv::glyph_atlas::globalStats().fallbacks == spaced.fallbacks);
+
+  testWrite(sFancy_Atlas_FullFile, atlased);
+}
+
+TEST(Fancy_LabelCache, "puttextfancy_labelcache") {
+  // Tracker-style overlay: the same labels every frame, moving, over a changing background
+  cv::label_cache cache;
+  const auto frame = [](cv::Mat& img, int t, cv::label_cache* labels, cv::Rect* box){
+    for(int y = 0; y < img.rows; ++y)
+      img.row(y).setTo(cv::Scalar((y + t) % 256, (2*y) % 256, 128));
+    for(int i = 0; i < 6; ++i){
+      const cv::Point at(20 + 130*i + 7*t, 30 + 90*i + 5*t);
+      cv::putTextOutline(img, at, fancy::White, 2, 0.8, 1.1, fancy::Black, 3)
+          .labelCache(labels)
+        << "car #" << i << "\n" << "0.9" << i;
+      cv::putTextShadow(img, at + cv::Point(0, 300)).labelCache(labels) << "person";
+      cv::putTextBackground(img, at + cv::Point(400, 0)).labelCache(labels).setTextboxResult(box)
+        << "id " << i;
+    }
+    // Against the border; drawn normally
+    cv::putTextOutline(img, cv::Point(img.cols - 60, 10)).labelCache(labels) << "edge";
+  };
+
+  cv::Mat fresh(900, 1200, CV_8UC3), cached(900, 1200, CV_8UC3);
+  cv::Rect freshBox, cachedBox;
+  for(int t = 0; t < 4; ++t){
+    frame(fresh, t, nullptr, &freshBox);
+    frame(cached, t, &cache, &cachedBox);
+    CV_Assert(cv::norm(fresh, cached, cv::NORM_INF) == 0 && freshBox == cachedBox);
+  }
+  auto stats = cache.stats();
+  CV_Assert(stats.hits > 0 && stats.bypasses > 0 && stats.entries > 0 && stats.bytes <= stats.budget);
+  CV_Assert(stats.hitRate() > 0.5);
+
+  // Anti-aliased pixels re-blended from their coverage; close, not exact
+  cache.setExact(false);
+  for(int t = 0; t < 2; ++t){
+    frame(fresh, t, nullptr, &freshBox);
+    frame(cached, t, &cache, &cachedBox);
+    CV_Assert(cv::norm(fresh, cached, cv::NORM_INF) <= 2 && freshBox == cachedBox);
+  }
+
+  // Taken through operator<<, with the other settings
+  cv::label_cache chained;
+  cv::Mat drawn(100, 300, CV_8UC3, fancy::Grey);
+  cv::putText(drawn, cv::Point(20, 40)) << cv::putTextOutline() << "chained";
+  for(int t = 0; t < 2; ++t){
+    cv::Mat blitted(drawn.size(), drawn.type(), fancy::Grey);
+    cv::putText(blitted, cv::Point(20, 40)) << cv::putTextOutline().labelCache(&chained) << "chained";
+    CV_Assert(cv::norm(drawn, blitted, cv::NORM_INF) == 0);
+  }
+  CV_Assert(chained.stats().entries == 1 && chained.stats().hits == 1);
+
+  // Evicted down to the budget
+  cache.setBudget(stats.bytes / 4);
+  stats = cache.stats();
+  CV_Assert(stats.bytes <= stats.budget && stats.entries > 0);
+
+  testWrite(sFancy_LabelCache_FullFile, cached);
+}
+
+TEST(Fancy_Batch, "puttextfancy_batch") {
+  cv::text_style style, small;
+  style.color = fancy::White;
+  small.fontScale = 0.6;
+  small.backend = cv::image_ostream::Backend::Atlas;
+  cv::fancy_style outline, shadow, background;
+  outline.outlineColor = fancy::Black;
+  shadow.outlineColor = fancy::Black;
+  shadow.outlineThickness = 2;
+  shadow.shadow = true;
+  background.bgColor = fancy::White;
+  std::vector<cv::fancy_label> labels;
+  for(int i = 0; i < 120; ++i){
+    const cv::Point at(20 + (89*i) % 650, 20 + (41*i) % 420);
+    labels.push_back({at, "car #" + std::to_string(i), style, i % 2 ? outline : shadow});
+    labels.push_back({at + cv::Point(0, 30), "0.9" + std::to_string(i % 10), small,
+        i % 3 ? std::optional<cv::fancy_style>(background) : std::nullopt});
+  }
+
+  cv::Mat chained(500, 800, CV_8UC3, fancy::Grey);
+  cv::Mat batched = chained.clone();
+  std::vector<cv::Rect> boxes;
+  for(const auto& l : labels){
+    const cv::text_style& s = l.style;
+    cv::Rect box;
+    if(l.fancy){
+      const cv::fancy_style& f = l.fancy.value();
+      cv::putTextFancy(chained, l.origin, f.outlineColor, f.outlineThickness, f.shadow, f.bgColor,
+          f.bgFilled, f.bgBaselinePad, s.color, s.thickness, s.fontScale, s.lineSpacing, s.fontFace,
+          s.lineType, s.bottomLeftOrigin, s.align, s.reverse, s.backend).setTextboxResult(&box)
+        << l.text;
+    }else{
+      cv::putText(chained, l.origin, s.color, s.thickness, s.fontScale, s.lineSpacing, s.fontFace,
+          s.lineType, s.bottomLeftOrigin, s.align, s.reverse, s.backend).setTextboxResult(&box)
+        << l.text;
+    }
+    boxes.push_back(box);
+  }
+  std::vector<cv::Rect> batchedBoxes;
+  cv::putTextBatch(batched, labels, &batchedBoxes);
+  CV_Assert(cv::norm(chained, batched, cv::NORM_INF) == 0 && boxes == batchedBoxes);
+
+  // And through a label_cache, composing then blitting
+  cv::label_cache cache;
+  for(int frame = 0; frame < 2; ++frame){
+    cv::Mat cached(500, 800, CV_8UC3, fancy::Grey);
+    cv::putTextBatch(cached, labels, &batchedBoxes, &cache);
+    CV_Assert(cv::norm(chained, cached, cv::NORM_INF) == 0 && boxes == batchedBoxes);
+  }
+  CV_Assert(cache.stats().hits > 0);
+
+  // In parallel bands, then serially
+  const int threads = cv::getNumThreads();
+  for(const int n : {4, 1}){
+    cv::setNumThreads(n);
+    batched.setTo(fancy::Grey);
+    cv::putTextBatch(batched, labels, &batchedBoxes);
+    CV_Assert(cv::norm(chained, batched, cv::NORM_INF) == 0 && boxes == batchedBoxes);
+  }
+  cv::setNumThreads(threads);
+
+  testWrite(sFancy_Batch_FullFile, batched);
+}
+
+TEST(Fancy_DisplayList, "puttextfancy_displaylist") {
+  // A static HUD: recorded once, flushed onto every frame
+  const auto hud = [](cv::InputOutputArray img, cv::display_list* list, cv::Rect* box){
+    cv::putText(img, cv::Point(20, 20), fancy::Red).displayList(list).setTextboxResult(box)
+      << "Camera 3" << std::endl << std::setprecision(3) << CV_PI << " fps";
+    cv::putTextOutline(img, cv::Point(400, 30)).displayList(list).backend(cv::image_ostream::Backend::Atlas)
+      << "REC" << cv::putTextShadow(fancy::Green) << "\nshadowed";
+    cv::putTextBackground(img, cv::Point(780, 480)).displayList(list).align(fancy::TA::Right)
+      .bottomLeftOrigin(true).reverse(true)
+      << "2024-01-01\n12:00:00";
+    cv::putTextFancy_RelativeTo(img, cv::Rect(300, 200, 200, 100), fancy::VA::Bottom, fancy::TA::Center)
+      .displayList(list)
+      << cv::putTextOutline(fancy::White, 1, 0.6, 1.1, fancy::Blue, 2) << "zone A";
+  };
+
+  cv::display_list list;
+  cv::Mat blank(500, 800, CV_8UC3, fancy::Grey);
+  cv::Mat recorded = blank.clone();
+  cv::Rect drawnBox, recordedBox;
+  hud(recorded, &list, &recordedBox);
+  CV_Assert(cv::norm(recorded, blank, cv::NORM_INF) == 0 && !list.empty()); // nothing drawn yet
+
+  const auto metrics = cv::text_metrics_cache::global().stats();
+  for(int frame = 0; frame < 3; ++frame){
+    cv::Mat drawn(500, 800, CV_8UC3, cv::Scalar(40*frame, 200, 120));
+    cv::Mat flushed = drawn.clone();
+    hud(drawn, nullptr, &drawnBox);
+    list.flush(flushed);
+    CV_Assert(cv::norm(drawn, flushed, cv::NORM_INF) == 0 && drawnBox == recordedBox);
+    if(frame == 2) testWrite(sFancy_DisplayList_FullFile, flushed);
+  }
+  // Only the direct draws measured
+  const auto after = cv::text_metrics_cache::global().stats();
+  list.flush(blank);
+  CV_Assert(cv::text_metrics_cache::global().stats().direct == after.direct && after.direct > metrics.direct);
+}
+
+TEST(Fancy_Move, "puttextfancy_move") {
+  cv::Mat img(500, 800, CV_8UC3, fancy::White);
+  // A moved stream hands over its text, formatting and results; only the last owner draws
+  cv::display_list list;
+  cv::Size size;
+  {
+    auto a = cv::putText(img, cv::Point(40, 40), fancy::Blue);
+    a.displayList(&list).setTextSizeResult(&size) << "moved " << std::setprecision(3);
+    cv::image_ostream b(std::move(a));
+    b << CV_PI;
+    cv::image_ostream_fancy c(std::move(b));
+    c << "\nand made fancy";
+    cv::image_ostream_fancy d(std::move(c));
+  }
+  std::vector<std::string> lines;
+  for(const auto& command : list.commands())
+    if(command.kind == cv::display_list::Command::Kind::Text) lines.push_back(command.text);
+  CV_Assert(lines == std::vector<std::string>({"moved 3.14", "and made fancy"}) && size.width > 0);
+  list.flush(img);
+
+  // A plain stream moved into fancy settings hands over its pending text; it's drawn once
+  cv::display_list handed;
+  {
+    auto plain = cv::putText(cv::noArray(), cv::Point(40, 300));
+    plain.displayList(&handed) << "plain, ";
+    std::move(plain) << cv::putTextOutline() << "then outlined";
+  }
+  // A named one is copied, like a saved format: both keep its text, and it goes on drawing
+  {
+    auto named = cv::putText(cv::noArray(), cv::Point(40, 300));
+    named.displayList(&handed) << "named, " << cv::putTextShadow() << "then shadowed";
+    named << "and more";
+  }
+  lines.clear();
+  for(const auto& command : handed.commands())
+    if(command.kind != cv::display_list::Command::Kind::Marker) lines.push_back(command.text);
+  CV_Assert(lines == std::vector<std::string>({"plain, ", "then outlined",
+      "named, ", "then shadowed", "named, and more"}));
+
+  // Switching between saved formats copies settings only
+  const auto fmt_BoldRed = cv::putText(fancy::Red, 4, 1.3, 0.9);
+  const auto fmt_Outline = cv::putTextOutline(fancy::Red, 4, 2.0);
+  auto out = cv::putTextFancy(img, cv::Point(40, 200));
+  const size_t before = g_allocations;
+  out << fmt_BoldRed << fmt_Outline << fmt_BoldRed << fmt_Outline;
+  CV_Assert(g_allocations == before);
+  out << "Outlined, after four switches";
+
+  testWrite(sFancy_Move_FullFile, img);
+}
+
+TEST(Fancy_Damage, "puttextfancy_damage") {
+  const cv::Mat blank(500, 800, CV_8UC3, fancy::Grey);
+  // Every changed pixel is in the region, of at most maxRects rectangles
+  const auto check = [&blank](const cv::Mat& img, const cv::damage_region& region, size_t maxRects){
+    cv::Mat outside = img.clone();
+    for(const cv::Rect& r : region.rects()){
+      CV_Assert((r & cv::Rect(cv::Point(0, 0), img.size())) == r);
+      blank(r).copyTo(outside(r));
+    }
+    CV_Assert(cv::norm(outside, blank, cv::NORM_INF) == 0);
+    CV_Assert(!region.empty() && region.rects().size() <= maxRects);
+    // and no more: every edge of every rectangle has a changed pixel
+    for(const cv::Rect& r : region.rects()){
+      const auto changed = [&](const cv::Rect& edge){ return cv::norm(img(edge), blank(edge), cv::NORM_INF) > 0; };
+      CV_Assert(changed(cv::Rect(r.x, r.y, r.width, 1)) && changed(cv::Rect(r.x, r.br().y - 1, r.width, 1)));
+      CV_Assert(changed(cv::Rect(r.x, r.y, 1, r.height)) && changed(cv::Rect(r.br().x - 1, r.y, 1, r.height)));
+    }
+  };
+  const auto scene = [](cv::Mat& img, cv::damage_region* region, cv::display_list* list){
+    cv::putText(img, cv::Point(20, 20), fancy::Red, 1, 0.6).damage(region).displayList(list)
+      << "FPS: " << 30;
+    cv::putTextOutline(img, cv::Point(400, 60), fancy::White, 2, 1.0, 1.1, fancy::Black, 4).damage(region)
+        .displayList(list)
+      << "Outlined" << cv::putTextShadow(fancy::Green) << "\nShadowed (|g{y})";
+    cv::putTextBackground(img, cv::Point(790, 490)).damage(region).displayList(list).align(fancy::TA::Right)
+      .bottomLeftOrigin(true).reverse(true)
+      << "At the\ncorner";
+    cv::putTextOutline(img, cv::Point(-30, 300), fancy::White, 1, 1.5).damage(region).displayList(list)
+      << "Over the border";
+    cv::putTextBackground(img, cv::Point(250, 400), fancy::Black, fancy::White, false).damage(region)
+        .displayList(list).lineType(cv::LINE_AA)
+      << "Unfilled";
+  };
+
+  cv::Mat img = blank.clone();
+  cv::damage_region region;
+  scene(img, &region, nullptr);
+  check(img, region, 8);
+  CV_Assert(region.area() < img.total() / 4);
+
+  // Flushing a display list reports the same region
+  cv::display_list list;
+  cv::Mat flushed = blank.clone();
+  cv::damage_region flushedRegion;
+  scene(flushed, nullptr, &list);
+  list.flush(flushed, &flushedRegion);
+  CV_Assert(flushedRegion.rects() == region.rects());
+
+  // Squeezed into fewer rectangles, it still covers everything
+  cv::damage_region two(2);
+  for(const cv::Rect& r : region.rects()) two.add(r);
+  check(img, two, 2);
+
+  for(const cv::Rect& r : region.rects()) cv::rectangle(img, r, fancy::Blue, 1);
+  testWrite(sFancy_Damage_FullFile, img);
+}
+
+TEST(Fancy_Overlay, "puttextfancy_overlay") {
+  // A static HUD, recorded once; frames under it are striped, so what shows through matters
+  cv::display_list hud;
+  const auto record = [&hud](const std::string& camera, cv::LineTypes lineType){
+    hud.clear();
+    cv::putTextOutline(cv::noArray(), cv::Point(20, 20), fancy::White, 2, 0.8).displayList(&hud)
+        .lineType(lineType)
+      << camera << cv::putTextShadow(fancy::Green) << "\nlegend: cars, people";
+    cv::putTextBackground(cv::noArray(), cv::Point(790, 490)).displayList(&hud).align(fancy::TA::Right)
+        .bottomLeftOrigin(true).reverse(true).lineType(lineType)
+      << "(c) watermark\n2026";
+    cv::putText(cv::noArray(), cv::Point(300, 250), fancy::Red, 1, 1.5).displayList(&hud).lineType(lineType)
+        .backend(cv::image_ostream::Backend::Atlas)
+      << "CENTER";
+  };
+  const auto frame = [](int type, int k){
+    cv::Mat f(500, 800, type, cv::Scalar::all(0));
+    for(int y = 0; y < f.rows; y += 20)
+      f.rowRange(y, std::min(f.rows, y + 10)).setTo(cv::Scalar(40*k, 255 - 30*k, 90 + y/4, 255));
+    return f;
+  };
+
+  // Opaque text composites to the same pixels as drawing it, for each frame type
+  record("Camera 1", cv::LINE_8);
+  cv::Mat img;
+  for(const int type : {CV_8UC3, CV_8UC1, CV_8UC4}){
+    cv::text_overlay overlay(cv::Size(800, 500), type);
+    CV_Assert(overlay.update(hud) && !overlay.update(hud));
+    CV_Assert(!overlay.empty() && overlay.tiles().size() < size_t(13*8)/2);
+    for(int k = 0; k < 3; ++k){
+      cv::Mat drawn = frame(type, k), composited = drawn.clone(), scalar = drawn.clone();
+      hud.flush(drawn);
+      overlay.composite(composited);
+      overlay.compositeScalar(scalar);
+      CV_Assert(cv::norm(drawn, composited, cv::NORM_INF) == 0);
+      CV_Assert(cv::norm(scalar, composited, cv::NORM_INF) == 0);
+      if(type == CV_8UC3 && k == 0) img = composited;
+    }
+  }
+
+  // Antialiased edges are within a rounding step; changing the HUD rebuilds it
+  cv::text_overlay overlay(cv::Size(800, 500));
+  overlay.update(hud);
+  record("Camera 2", cv::LINE_AA);
+  CV_Assert(overlay.update(hud) && !overlay.update(hud));
+  cv::Mat drawn = frame(CV_8UC3, 1), composited = drawn.clone();
+  hud.flush(drawn);
+  overlay.composite(composited);
+  CV_Assert(cv::norm(drawn, composited, cv::NORM_INF) <= 2);
+  overlay.clear();
+  CV_Assert(overlay.empty() && overlay.update(hud));
+
+  testWrite(sFancy_Overlay_FullFile, img);
+}
+
+TEST(Fancy_Stats, "puttextfancy_stats") {
+  // Counted per thread, summed on snapshot(); nothing while disabled
+  cv::Mat img(300, 600, CV_8UC3, fancy::Grey);
+  cv::render_stats::reset();
+  cv::putText(img, cv::Point(20, 20)) << "not counted";
+  CV_Assert(cv::render_stats::snapshot().lines == 0);
+
+  cv::render_stats::enable();
+  cv::putText(img, cv::Point(20, 20), fancy::Black, 1) << "ab\ncd\nefg";
+  cv::putTextOutline(img, cv::Point(20, 120), fancy::White, 1, 1.0, 1.1, fancy::Black, 2) << "hi";
+  cv::putTextBackground(img, cv::Point(200, 20)) << "bg";
+  std::thread([&img]{ cv::putText(img, cv::Point(200, 120), fancy::Red, 1) << "thread"; }).join();
+  cv::putText(img, cv::Point(700, 20)) << "off the image";
+  cv::render_stats::enable(false);
+
+  const cv::render_stats::Counters c = cv::render_stats::snapshot();
+  CV_Assert(c.lines == 3 + 1 + 1 + 1);
+  CV_Assert(c.chars == 7 + 2 + 2 + 6);
+  CV_Assert(c.putTextCalls == 3 + 2 + 1 + 1);
+  CV_Assert(c.backgrounds == 1);
+  CV_Assert(c.boundsArea > 0 && c.measureTicks > 0);
+  CV_Assert(c.textTicks > 0 && c.outlineTicks > 0 && c.backgroundTicks > 0);
+  cv::render_stats::reset();
+  CV_Assert(cv::render_stats::snapshot().lines == 0 && cv::render_stats::snapshot().textTicks == 0);
+
+  cv::putText(img, cv::Point(20, 200), fancy::Black, 1)
+    << "lines " << c.lines << ", chars " << c.chars << ", putText " << c.putTextCalls
+    << "\nbackgrounds " << c.backgrounds << ", bounds area " << c.boundsArea;
+  testWrite(sFancy_Stats_FullFile, img);
+}
+
+TEST(Fancy_Trace, "puttextfancy_trace") {
+  // A begin/end span per block drawn, with its length, style and Textbox, oldest first
+  cv::Mat img(300, 600, CV_8UC3, fancy::Grey);
+#ifdef CV2_PUTTEXT_TRACE
+  cv::trace_buffer::clear();
+  cv::Rect plainBox, fancyBox;
+  cv::putText(img, cv::Point(20, 20), fancy::Black, 1, 0.8).setTextboxResult(&plainBox) << "two\nlines";
+  cv::putTextFancy(img, cv::Point(20, 120), fancy::Black, 2, false, fancy::White)
+    .setTextboxResult(&fancyBox) << "outlined \"quoted\"";
+  std::thread([&img]{ cv::putText(img, cv::Point(300, 20), fancy::Red, 1) << "thread"; }).join();
+
+  const std::vector<cv::trace_buffer::Event> events = cv::trace_buffer::events();
+  CV_Assert(events.size() == 6);
+  for(size_t i = 0; i < events.size(); ++i){
+    CV_Assert(events[i].phase == (i % 2 ? 'E' : 'B'));
+    CV_Assert(i == 0 || events[i].ticks >= events[i - 1].ticks);
+  }
+  CV_Assert(events[1].chars == 9 && events[1].lines == 2 && events[1].fontScale == 0.8 && events[1].box == plainBox);
+  CV_Assert(events[3].decorations == (cv::trace_buffer::Outline | cv::trace_buffer::Background));
+  CV_Assert(events[3].box == fancyBox && std::string(events[3].text) == "outlined \"quoted\"");
+  CV_Assert(events[5].thread != events[1].thread);
+  const std::string json = cv::trace_buffer::chromeJson();
+  CV_Assert(json.find("\"traceEvents\"") != std::string::npos && json.find("\\\"quoted\\\"") != std::string::npos);
+
+  // The oldest are overwritten
+  cv::trace_buffer::setCapacity(4);
+  for(const char* text : {"a", "b", "c"}) cv::putText(img, cv::Point(20, 200)) << text;
+  const std::vector<cv::trace_buffer::Event> last = cv::trace_buffer::events();
+  CV_Assert(last.size() == 4 && std::string(last[0].text) == "b" && std::string(last[3].text) == "c");
+  cv::trace_buffer::setCapacity(65536);
+
+  // The text is cut at a code point: 23 bytes would end inside the em dash
+  cv::putText(img, cv::Point(300, 200), fancy::Black, 1, 0.5, 1.1, cv::FONT_HERSHEY_COMPLEX)
+    << "Entrée: quai nº 12 — fermé";
+  CV_Assert(std::string(cv::trace_buffer::events().back().text) == "Entrée: quai nº 12 ");
+
+  cv::putText(img, cv::Point(20, 240), fancy::Black, 1)
+    << events.size() << " events, " << last.size() << " after wrapping";
+#else
+  cv::putText(img, cv::Point(20, 20), fancy::Black, 1) << "Built without CV2_PUTTEXT_TRACE";
+#endif
+  testWrite(sFancy_Trace_FullFile, img);
+}
+
+TEST(Fancy_Threads, "puttextfancy_threads") {
+  // One annotation thread per camera, each on its own image: every frame must match drawing it
+  // alone, while the shared stats are read from another thread. Also the TSan target's test
+  using Backend = cv::image_ostream::Backend;
+  const auto scene = [](cv::Mat& img, int camera, cv::label_cache& labels){
+    const cv::Scalar tint(40*camera, 120, 200 - 30*camera);
+    cv::putText(img, cv::Point(20, 20), fancy::Black, 1, 0.6) << "Camera " << camera << "\nfps: " << 29.97 + camera;
+    cv::putText(img, cv::Point(20, 80), tint, 1).backend(Backend::Atlas) << "Atlas " << camera;
+    cv::putTextOutline(img, cv::Point(20, 130), fancy::White, 1, 0.8, 1.1, tint, 2).backend(Backend::Atlas)
+      << "Outlined " << camera * 7;
+    cv::putTextShadow(img, cv::Point(20, 180), fancy::White, 1, 0.8) << "Shadow";
+    cv::putTextBackground(img, cv::Point(20, 230), fancy::Black, tint, true, 1, 0.6) << "Background " << camera;
+    for(int i = 0; i < 3; ++i)
+      cv::putTextOutline(img, cv::Point(300, 20 + 40*i), fancy::White, 1, 0.6, 1.1, fancy::Black, 2)
+        .labelCache(&labels) << "track " << i;
+    std::vector<cv::text_label> batch;
+    for(int i = 0; i < 80; ++i)
+      batch.push_back({cv::Point(300 + (i % 8)*30, 150 + (i / 8)*14), std::to_string(i + camera), {}});
+    for(cv::text_label& label : batch){ label.style.fontScale = 0.3; label.style.thickness = 1; }
+    cv::putTextBatch(img, batch);
+  };
+
+  const int cameras = 4, frames = 10;
+  std::vector<cv::Mat> expected(cameras);
+  for(int camera = 0; camera < cameras; ++camera){
+    cv::label_cache labels;
+    expected[camera] = cv::Mat(300, 600, CV_8UC3, fancy::Grey);
+    scene(expected[camera], camera, labels);
+  }
+
+  std::atomic<int> mismatches{0};
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for(int camera = 0; camera < cameras; ++camera){
+    threads.emplace_back([&, camera]{
+      cv::label_cache labels;
+      for(int frame = 0; frame < frames; ++frame){
+        cv::Mat img(300, 600, CV_8UC3, fancy::Grey);
+        scene(img, camera, labels);
+        if(cv::norm(img, expected[camera], cv::NORM_INF) != 0) ++mismatches;
+      }
+    });
+  }
+  std::thread reader([&]{
+    while(!done){
+      cv::glyph_atlas::globalStats();
+      cv::render_stats::snapshot();
+      std::this_thread::yield();
+    }
+  });
+  for(std::thread& thread : threads) thread.join();
+  done = true;
+  reader.join();
+  CV_Assert(mismatches == 0);
+  CV_Assert(cv::glyph_atlas::globalStats().hits > 0);
+
+  testWrite(sFancy_Threads_FullFile, expected[cameras - 1]);
 }
 
 TEST(Fancy_Background, "puttextfancy_background") {
@@ -411,7 +1579,7 @@ TEST(Fancy_Background, "puttextfancy_background") {
   << cv::putTextBackground()
     << "Default again" << std::endl
   ;
-  cv::imwrite(sFancy_Background_FullFile, img);
+  testWrite(sFancy_Background_FullFile, img);
 }
 
 TEST(Fancy_Demo, "puttextfancy_demo") {
@@ -445,7 +1613,7 @@ TEST(Fancy_Demo, "puttextfancy_demo") {
     << "need to fill with whitespace!  " << std::endl
     << "Note: no HERSHEY Mono font, tho" << std::endl
   ;
-  cv::imwrite(sFancy_Demo_FullFile, img);
+  testWrite(sFancy_Demo_FullFile, img);
 }
 
 TEST(Fancy_Sizes, "puttextfancy_sizes") {
@@ -479,7 +1647,7 @@ TEST(Fancy_Sizes, "puttextfancy_sizes") {
   }
   cv::rectangle(img, origin, origin + textSize, fancy::Black);
 
-  cv::imwrite(sFancy_Sizes_FullFile, img);
+  testWrite(sFancy_Sizes_FullFile, img);
 }
 
 TEST(Fancy_RelativeTo, "puttextfancy_relativeto"){
@@ -508,7 +1676,7 @@ TEST(Fancy_RelativeTo, "puttextfancy_relativeto"){
   cv::putTextFancy_RelativeTo(img, rect, fancy::TextAlign::Right, fancy::VertAlign::Bottom, false, true).setOriginResult(&origin).setTextboxResult(&bbox) << cv::putTextShadow() << "RB" << "\nbottomLeft\n_origin=True!"; box();
   cv::putTextFancy_RelativeTo(img, rect, fancy::TextAlign::Left, fancy::VertAlign::Top, false, true).setOriginResult(&origin).setTextboxResult(&bbox) << cv::putTextBackground() << "LT" << "\nbottomLeft\n_origin=True!"; box();
 
-  cv::imwrite(sFancy_RelativeTo_FullFile, img);
+  testWrite(sFancy_RelativeTo_FullFile, img);
 }
 
 /*
@@ -522,7 +1690,7 @@ TEST(Fancy_IntoReg1, "puttextfancy_intoreg1"){
   << cv::putText()
     << "Yes, it can!" << std::endl
   ;
-  cv::imwrite(sFancy_IntoReg1_FullFile, img);
+  testWrite(sFancy_IntoReg1_FullFile, img);
 }
 */
 
@@ -541,7 +1709,7 @@ TEST(Fancy_IntoReg2, "puttextfancy_intoreg2"){
       << "Yes, it can!" << std::endl
     ;
   }
-  cv::imwrite(sFancy_IntoReg2_FullFile, img);
+  testWrite(sFancy_IntoReg2_FullFile, img);
 }
 */
 
@@ -559,12 +1727,34 @@ TEST(Fancy_IntoReg2, "puttextfancy_intoreg2"){
   X(Normal_StackFmts) \
   X(Normal_Demo) \
   X(Normal_Sizes) \
+  X(Normal_MetricsCache) \
+  X(Normal_TextBuffer) \
+  X(Normal_Numbers) \
+  X(Normal_Layout) \
+  X(Normal_Placement) \
+  X(Normal_Culling) \
+  X(Normal_Hud) \
+  X(Normal_GlyphMetrics) \
+  X(Normal_Atlas) \
+  X(Normal_MaskBlend) \
+  X(Normal_Batch) \
+  X(Normal_BatchBands) \
   X(Normal_Refs) \
   X(Fancy_Normal) \
   X(Fancy_SetChains) \
   X(Fancy_Stack) \
   X(Fancy_Outline) \
   X(Fancy_Shadow) \
+  X(Fancy_Atlas) \
+  X(Fancy_LabelCache) \
+  X(Fancy_Batch) \
+  X(Fancy_DisplayList) \
+  X(Fancy_Move) \
+  X(Fancy_Damage) \
+  X(Fancy_Overlay) \
+  X(Fancy_Stats) \
+  X(Fancy_Trace) \
+  X(Fancy_Threads) \
   X(Fancy_Background) \
   X(Fancy_Demo) \
   X(Fancy_Sizes) \
@@ -574,9 +1764,174 @@ TEST(Fancy_IntoReg2, "puttextfancy_intoreg2"){
 
 #define STR_EQ(a, b) (strcmp(a, b) == 0)
 
+struct TestCase {
+  const char* name;
+  const char* file;
+  void (*run)();
+};
+static const TestCase g_tests[] = {
+#define X(NAME) {ac##NAME, FileVar(NAME), NAME},
+  ALL_TESTS
+#undef X
+};
+
+// Budgets are recorded at twice the time taken, to leave room for noise
+static const double kBudgetSlack = 2.0;
+
+static std::map<std::string, double> readBudgets(const std::string& path) {
+  std::map<std::string, double> budgets;
+  std::ifstream in(path);
+  std::string name;
+  double us;
+  while(in >> name >> us) budgets[name] = us;
+  return budgets;
+}
+
+// Compares img with the reference, pixel by pixel; where they differ, writes diffFile (255 at
+// each differing pixel) and sets why to how much: pixels, the largest channel difference, and where
+static bool compareGolden(const cv::Mat& img, const cv::Mat& ref, const std::string& diffFile, std::string& why) {
+  std::ostringstream os;
+  if(ref.empty()){
+    why = "no reference image";
+    return false;
+  }
+  if(img.size() != ref.size() || img.type() != ref.type() || img.depth() != CV_8U){
+    os << "image " << img.size() << " type " << img.type() << ", reference " << ref.size() << " type " << ref.type();
+    why = os.str();
+    return false;
+  }
+  cv::Mat diff, mask(img.size(), CV_8UC1, cv::Scalar::all(0));
+  cv::absdiff(img, ref, diff);
+  const int cn = diff.channels();
+  int pixels = 0, maxDiff = 0;
+  cv::Point tl(INT_MAX, INT_MAX), br(-1, -1);
+  for(int y = 0; y < diff.rows; ++y){
+    const uchar* d = diff.ptr<uchar>(y);
+    for(int x = 0; x < diff.cols; ++x){
+      int m = 0;
+      for(int c = 0; c < cn; ++c) m = std::max(m, (int)d[x*cn + c]);
+      if(!m) continue;
+      ++pixels;
+      maxDiff = std::max(maxDiff, m);
+      tl = cv::Point(std::min(tl.x, x), std::min(tl.y, y));
+      br = cv::Point(std::max(br.x, x), std::max(br.y, y));
+      mask.at<uchar>(y, x) = 255;
+    }
+  }
+  if(!pixels) return true;
+  cv::imwrite(diffFile, mask);
+  os << pixels << " pixels differ, by up to " << maxDiff << ", in " << cv::Rect(tl, br + cv::Point(1, 1))
+    << "; see " << diffFile;
+  why = os.str();
+  return false;
+}
+
+// The golden harness. Runs each test (all, or those named) once and compares its image with
+// dir/<file>.png, then times it over iterations runs, without writing, against its budget in
+// dir/budgets.txt (the median must be within it). With record, saves the images and budgets
+// instead, from a known-good build. With baseline, dir has the images the baseline tree's own
+// test wrote, drawn by cv::putText() alone: only the images are compared, and tests it didn't
+// have are skipped. Returns the number of failures
+static int runGolden(const std::string& dir, bool record, bool baseline, int iterations, const std::vector<std::string>& names) {
+  const std::string budgetFile = dir + "/budgets.txt";
+  std::map<std::string, double> budgets = readBudgets(budgetFile);
+  auto& debug = cv::image_ostream::_Debug;
+  int failures = 0, skipped = 0;
+  for(const TestCase& t : g_tests){
+    if(!names.empty() && std::find(names.begin(), names.end(), t.name) == names.end()) continue;
+    std::string why;
+    bool ok = true;
+    double median = 0;
+    const std::string ref = dir + "/" + t.file + ".png";
+    if(baseline && cv::imread(ref, cv::IMREAD_UNCHANGED).empty()){
+      std::printf("%-4s %-20s  not in the baseline\n", "skip", t.name);
+      ++skipped;
+      continue;
+    }
+    const bool verifyMetrics = debug.verify_metrics, verifyBackend = debug.verify_backend;
+    try {
+      g_written.release();
+      t.run();
+      const cv::Mat img = g_written.clone();
+      if(record){
+        if(!cv::imwrite(ref, img)){ ok = false; why = "can't write " + ref; }
+      }else{
+        ok = compareGolden(img, cv::imread(ref, cv::IMREAD_UNCHANGED), std::string(t.file) + "_diff.png", why);
+      }
+
+      // Timed without the verification, which only checks, and without the PNG writes
+      debug.verify_metrics = debug.verify_backend = false;
+      g_timing = true;
+      std::vector<double> times;
+      for(int i = 0; i < iterations && !baseline; ++i){
+        const int64 t0 = cv::getTickCount();
+        t.run();
+        times.push_back((cv::getTickCount() - t0)*1e6/cv::getTickFrequency());
+      }
+      if(!times.empty()){
+        std::nth_element(times.begin(), times.begin() + times.size()/2, times.end());
+        median = times[times.size()/2];
+      }
+      if(baseline){
+        // Only the pixels: the baseline's times aren't this build's budgets
+      }else if(record){
+        budgets[t.name] = median*kBudgetSlack;
+      }else if(!budgets.count(t.name)){
+        if(ok) why = "no budget";
+        ok = false;
+      }else if(median > budgets[t.name]){
+        if(ok) why = "over budget";
+        ok = false;
+      }
+    } catch(const cv::Exception& e) {
+      ok = false;
+      why = e.what();
+    }
+    g_timing = false;
+    debug.verify_metrics = verifyMetrics;
+    debug.verify_backend = verifyBackend;
+
+    failures += !ok;
+    std::printf("%-4s %-20s", ok ? "ok" : "FAIL", t.name);
+    if(!baseline) std::printf(" %10.0f us", median);
+    if(budgets.count(t.name) && !baseline) std::printf(" / %10.0f us", budgets[t.name]);
+    if(!why.empty()) std::printf("  %s", why.c_str());
+    std::printf("\n");
+  }
+  if(record){
+    std::ofstream out(budgetFile);
+    for(const auto& budget : budgets) out << budget.first << " " << std::fixed << std::setprecision(0) << budget.second << "\n";
+    if(!out){ std::printf("FAIL can't write %s\n", budgetFile.c_str()); ++failures; }
+  }
+  if(skipped) std::printf("%d skipped\n", skipped);
+  std::printf("%d failed\n", failures);
+  return failures;
+}
+
+// test [NAME|FILE...]: runs the tests (all, or those named), writing their images.
+// test --golden DIR [--iterations N] [NAME...]: checks them against DIR; --record DIR saves it.
+// test --baseline DIR [NAME...]: checks only their images, against those of the baseline tree
 int main(int argc, char** argv) {
   //cv::setBreakOnError(true);
   cv::image_ostream::_Debug.draw_origin = true;
+  cv::image_ostream::_Debug.verify_metrics = true;
+  cv::image_ostream::_Debug.verify_backend = true;
+  const char* golden = nullptr;
+  bool record = false, baseline = false;
+  int iterations = 10;
+  std::vector<std::string> names;
+  for(int i = 1; i < argc; i++) {
+    if((STR_EQ(argv[i], "--golden") || STR_EQ(argv[i], "--record") || STR_EQ(argv[i], "--baseline")) && i + 1 < argc) {
+      record = STR_EQ(argv[i], "--record");
+      baseline = STR_EQ(argv[i], "--baseline");
+      golden = argv[++i];
+    }else if(STR_EQ(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = std::max(1, std::atoi(argv[++i]));
+    }else{
+      names.push_back(argv[i]);
+    }
+  }
+  if(golden) return runGolden(golden, record, baseline, iterations, names) ? 1 : 0;
   try {
     if(argc > 1) {
       for(int i = 1; i < argc; i++) {